@@ -1,9 +1,20 @@
 #!/usr/bin/env bash
 
 # copied from https://github.com/olilarkin/ort-builder
+#
+# usage: build-ort-wasm.sh [--threads]
+#   --threads  build the pthreads variant into build/build-ort-wasm-mt, used
+#              by the basicpitch_simd_mt WASM target
+
+BUILD_DIR=./build/build-ort-wasm
+EXTRA_FLAGS=
+if [ "$1" == "--threads" ]; then
+    BUILD_DIR=./build/build-ort-wasm-mt
+    EXTRA_FLAGS=--enable_wasm_threads
+fi
 
 python3 ./vendor/onnxruntime/tools/ci_build/build.py \
---build_dir ./build/build-ort-wasm \
+--build_dir $BUILD_DIR \
 --config=MinSizeRel \
 --build_wasm_static_lib \
 --parallel \
@@ -14,6 +25,7 @@ python3 ./vendor/onnxruntime/tools/ci_build/build.py \
 --enable_reduced_operator_type_support \
 --skip_tests \
 --enable_wasm_simd \
+$EXTRA_FLAGS \
 --enable_wasm_exception_throwing_override \
 --disable_exceptions \
 --cmake_extra_defines \
@@ -0,0 +1,252 @@
+#!/usr/bin/env node
+// Headless benchmark of a WASM build under Node: transcribes synthetic clips
+// of the given lengths and any WAV files through the module's exports and
+// prints one JSON document with the realtime factor, per-stage timings
+// (model inference vs. note extraction + MIDI encoding) and heap sizes.
+//
+// usage: node scripts/wasm-bench.js [--build web/basicpitch.js]
+//            [--seconds 10,60] [--repeat 3] [--batch-chunks 8]
+//            [--out results.json] [file.wav ...]
+//
+// Times are the median over the repeats, after one untimed warm-up run per
+// input. WAV files (16/24/32-bit PCM or 32-bit float) are downmixed and
+// linearly resampled to 22050 Hz, which is enough for timing but not for
+// judging transcription quality. Builds without the bp_infer /
+// bp_notes_to_midi split only report the total time.
+
+const fs = require('fs');
+const path = require('path');
+const { SAMPLE_RATE, BATCH_CHUNKS, synthAudio, loadBuild } = require('./wasm-common');
+
+function parseArgs(argv) {
+    const args = {
+        build: path.join(__dirname, '../web/basicpitch.js'),
+        seconds: [10, 60],
+        repeat: 3,
+        batchChunks: BATCH_CHUNKS,
+        out: null,
+        files: []
+    };
+    for (let i = 0; i < argv.length; ++i) {
+        const arg = argv[i];
+        if (arg === '--build') {
+            args.build = argv[++i];
+        } else if (arg === '--seconds') {
+            args.seconds = argv[++i].split(',').filter(s => s !== '').map(Number);
+        } else if (arg === '--repeat') {
+            args.repeat = Math.max(1, parseInt(argv[++i], 10));
+        } else if (arg === '--batch-chunks') {
+            args.batchChunks = parseInt(argv[++i], 10);
+        } else if (arg === '--out') {
+            args.out = argv[++i];
+        } else if (arg === '-h' || arg === '--help') {
+            console.error(fs.readFileSync(__filename, 'utf8').split('\n').slice(1, 16).join('\n'));
+            process.exit(0);
+        } else {
+            args.files.push(arg);
+        }
+    }
+    args.build = path.resolve(args.build);
+    return args;
+}
+
+// Mono 22050 Hz samples of a WAV file
+function readWav(file) {
+    const buf = fs.readFileSync(file);
+    if (buf.toString('ascii', 0, 4) !== 'RIFF' || buf.toString('ascii', 8, 12) !== 'WAVE') {
+        throw new Error(`${file}: not a WAV file`);
+    }
+
+    let format = 0, channels = 0, rate = 0, bits = 0;
+    let data = null;
+    for (let offset = 12; offset + 8 <= buf.length;) {
+        const id = buf.toString('ascii', offset, offset + 4);
+        const size = buf.readUInt32LE(offset + 4);
+        const body = offset + 8;
+        if (id === 'fmt ') {
+            format = buf.readUInt16LE(body);
+            channels = buf.readUInt16LE(body + 2);
+            rate = buf.readUInt32LE(body + 4);
+            bits = buf.readUInt16LE(body + 14);
+            if (format === 0xfffe) {
+                format = buf.readUInt16LE(body + 24); // WAVE_FORMAT_EXTENSIBLE subformat
+            }
+        } else if (id === 'data') {
+            data = buf.subarray(body, Math.min(buf.length, body + size));
+        }
+        offset = body + size + (size & 1);
+    }
+    if (!data || !channels || !rate) {
+        throw new Error(`${file}: missing fmt or data chunk`);
+    }
+
+    const bytes = bits / 8;
+    let read;
+    if (format === 3 && bits === 32) {
+        read = i => data.readFloatLE(i);
+    } else if (format === 1 && bits === 16) {
+        read = i => data.readInt16LE(i) / 32768;
+    } else if (format === 1 && bits === 24) {
+        read = i => data.readIntLE(i, 3) / 8388608;
+    } else if (format === 1 && bits === 32) {
+        read = i => data.readInt32LE(i) / 2147483648;
+    } else {
+        throw new Error(`${file}: unsupported WAV format ${format}, ${bits} bit`);
+    }
+
+    const frames = Math.floor(data.length / (bytes * channels));
+    const mono = new Float32Array(frames);
+    for (let f = 0; f < frames; ++f) {
+        let sum = 0;
+        for (let c = 0; c < channels; ++c) {
+            sum += read((f * channels + c) * bytes);
+        }
+        mono[f] = sum / channels;
+    }
+    if (rate === SAMPLE_RATE) {
+        return mono;
+    }
+
+    const n = Math.floor(frames * SAMPLE_RATE / rate);
+    const resampled = new Float32Array(n);
+    const step = rate / SAMPLE_RATE;
+    for (let i = 0; i < n; ++i) {
+        const x = i * step;
+        const i0 = Math.floor(x);
+        const i1 = Math.min(i0 + 1, frames - 1);
+        resampled[i] = mono[i0] + (mono[i1] - mono[i0]) * (x - i0);
+    }
+    return resampled;
+}
+
+function median(values) {
+    const sorted = [...values].sort((a, b) => a - b);
+    const mid = sorted.length >> 1;
+    return sorted.length % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+}
+
+const round = (x, digits = 1) => +x.toFixed(digits);
+
+// One transcription with the default parameters, timed per stage
+function transcribe(mod, audioPointer, length, batchChunks, midiDataPointer, midiSizePointer) {
+    const configArgs = [0.5, 0.3, 27.5, 4186.0, 11, 120.0, 1, 1];
+    const start = performance.now();
+    let inferMs = null;
+    let midiMs = null;
+    if (typeof mod._bp_infer === 'function') {
+        mod._bp_infer(audioPointer, length, batchChunks);
+        const inferred = performance.now();
+        mod._bp_notes_to_midi(midiDataPointer, midiSizePointer, ...configArgs);
+        inferMs = inferred - start;
+        midiMs = performance.now() - inferred;
+    } else {
+        mod._convertToMidi(audioPointer, length, midiDataPointer, midiSizePointer, ...configArgs);
+        const midiData = mod.getValue(midiDataPointer, 'i32');
+        if (midiData) {
+            mod._free(midiData); // malloc'd copy
+        }
+    }
+    return {
+        totalMs: performance.now() - start,
+        inferMs,
+        midiMs,
+        midiBytes: mod.getValue(midiSizePointer, 'i32')
+    };
+}
+
+function benchInput(mod, name, audio, args) {
+    const audioPointer = mod._malloc(audio.length * 4);
+    if (!audioPointer) {
+        throw new Error(`${name}: insufficient WASM memory for the audio`);
+    }
+    mod.HEAPF32.set(audio, audioPointer >> 2);
+    const midiDataPointer = mod._malloc(4);
+    const midiSizePointer = mod._malloc(4);
+
+    transcribe(mod, audioPointer, audio.length, args.batchChunks, midiDataPointer, midiSizePointer);
+    const runs = [];
+    for (let r = 0; r < args.repeat; ++r) {
+        runs.push(transcribe(mod, audioPointer, audio.length, args.batchChunks, midiDataPointer, midiSizePointer));
+    }
+
+    let heapStats = {};
+    if (typeof mod._bp_heap_stats === 'function') {
+        const statsPointer = mod._malloc(16);
+        mod._bp_heap_stats(statsPointer, statsPointer + 8);
+        heapStats = {
+            malloc_in_use_bytes: mod.getValue(statsPointer, 'double'),
+            malloc_peak_footprint_bytes: mod.getValue(statsPointer + 8, 'double')
+        };
+        mod._free(statsPointer);
+    }
+
+    mod._free(audioPointer);
+    mod._free(midiDataPointer);
+    mod._free(midiSizePointer);
+
+    const seconds = audio.length / SAMPLE_RATE;
+    const totalMs = median(runs.map(run => run.totalMs));
+    const result = {
+        input: name,
+        audio_seconds: round(seconds, 2),
+        repeats: runs.length,
+        total_ms: round(totalMs),
+        infer_ms: runs[0].inferMs === null ? null : round(median(runs.map(run => run.inferMs))),
+        midi_ms: runs[0].midiMs === null ? null : round(median(runs.map(run => run.midiMs))),
+        realtime_factor: round(totalMs / 1000 / seconds, 4),
+        midi_bytes: runs[runs.length - 1].midiBytes,
+        // wasm memory only grows, so its current size is the peak so far
+        heap_bytes: mod.HEAPU8.length,
+        ...heapStats
+    };
+    if (typeof mod._bp_release_result === 'function') {
+        mod._bp_release_result();
+    }
+    return result;
+}
+
+async function main() {
+    const args = parseArgs(process.argv.slice(2));
+
+    // module logging would interleave with the JSON
+    const quiet = () => {};
+    const consoleLog = console.log;
+    console.log = quiet; // EM_JS log hooks call console.log directly
+    const { mod, loadMs, initMs } = await loadBuild(args.build, { print: quiet, printErr: quiet });
+
+    const inputs = args.seconds.map(seconds => ({
+        name: `synthetic-${seconds}s`,
+        audio: () => synthAudio(seconds)
+    })).concat(args.files.map(file => ({
+        name: file,
+        audio: () => readWav(file)
+    })));
+
+    const results = [];
+    for (const input of inputs) {
+        results.push(benchInput(mod, input.name, input.audio(), args));
+    }
+    console.log = consoleLog;
+
+    const report = {
+        build: path.basename(args.build),
+        node: process.version,
+        batch_chunks: args.batchChunks,
+        load_ms: round(loadMs),
+        init_ms: round(initMs),
+        results
+    };
+    const json = JSON.stringify(report, null, 2);
+    if (args.out) {
+        fs.writeFileSync(args.out, json + '\n');
+    }
+    process.stdout.write(json + '\n');
+
+    // pthread workers would keep Node alive
+    process.exit(0);
+}
+
+main().catch(err => {
+    console.error(err);
+    process.exit(1);
+});
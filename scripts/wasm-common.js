@@ -0,0 +1,56 @@
+// Helpers shared by the headless WASM scripts (wasm-node-check.js,
+// wasm-bench.js): loading a build under Node and deterministic test audio.
+
+const fs = require('fs');
+const path = require('path');
+
+const SAMPLE_RATE = 22050;
+const BATCH_CHUNKS = 8; // same as web/worker.js
+
+// A C major arpeggio with decaying partials, identical on every run
+function synthAudio(seconds) {
+    const n = Math.round(seconds * SAMPLE_RATE);
+    const audio = new Float32Array(n);
+    const notes = [60, 64, 67, 72];
+    const noteLength = Math.round(0.5 * SAMPLE_RATE);
+    for (let i = 0; i < n; ++i) {
+        const note = notes[Math.floor(i / noteLength) % notes.length];
+        const hz = 440 * Math.pow(2, (note - 69) / 12);
+        const t = (i % noteLength) / SAMPLE_RATE;
+        const envelope = Math.exp(-3 * t);
+        let sample = 0;
+        for (let k = 1; k <= 3; ++k) {
+            sample += Math.sin(2 * Math.PI * hz * k * (i / SAMPLE_RATE)) / k;
+        }
+        audio[i] = 0.3 * envelope * sample;
+    }
+    return audio;
+}
+
+// Loads a build and its model: the embedded one, or model.ort next to the
+// script for builds made with BASICPITCH_EMBED_MODEL=OFF. moduleOptions are
+// passed on to the module factory (e.g. print/printErr).
+async function loadBuild(script, moduleOptions = {}) {
+    const factory = require(script);
+    const loadStart = performance.now();
+    const mod = await factory({ mainScriptUrlOrBlob: script, ...moduleOptions });
+    const loadMs = performance.now() - loadStart;
+
+    let initMs = 0;
+    if (typeof mod._bp_init === 'function') {
+        const initStart = performance.now();
+        if (typeof mod._bp_has_embedded_model === 'function' && !mod._bp_has_embedded_model()) {
+            const model = fs.readFileSync(path.join(path.dirname(script), 'model.ort'));
+            const modelPointer = mod._malloc(model.length);
+            mod.HEAPU8.set(model, modelPointer);
+            mod._bp_init_with_model(modelPointer, model.length);
+            mod._free(modelPointer);
+        } else {
+            mod._bp_init();
+        }
+        initMs = performance.now() - initStart;
+    }
+    return { mod, loadMs, initMs };
+}
+
+module.exports = { SAMPLE_RATE, BATCH_CHUNKS, synthAudio, loadBuild };
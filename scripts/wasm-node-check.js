@@ -0,0 +1,62 @@
+#!/usr/bin/env node
+// Headless check of a WASM build under Node: loads the module, transcribes a
+// deterministic synthetic clip and verifies the result is a MIDI file.
+//
+// usage: node scripts/wasm-node-check.js [web/basicpitch.js | web/basicpitch-simd-mt.js] [seconds]
+//
+// The pthreads build needs Node's worker_threads (Node 16+). Exits non-zero
+// if the module fails to load or produces no MIDI data.
+
+const path = require('path');
+const { BATCH_CHUNKS, synthAudio, loadBuild } = require('./wasm-common');
+
+async function main() {
+    const script = path.resolve(process.argv[2] || path.join(__dirname, '../web/basicpitch.js'));
+    const seconds = parseFloat(process.argv[3] || '10');
+
+    const { mod, loadMs, initMs } = await loadBuild(script);
+
+    const audio = synthAudio(seconds);
+    const audioPointer = mod._malloc(audio.length * 4);
+    mod.HEAPF32.set(audio, audioPointer >> 2);
+    const midiDataPointer = mod._malloc(4);
+    const midiSizePointer = mod._malloc(4);
+    const configArgs = [0.5, 0.3, 27.5, 4186.0, 11, 120.0, 1, 1];
+
+    const runStart = performance.now();
+    if (typeof mod._bp_transcribe_batched === 'function') {
+        mod._bp_transcribe_batched(audioPointer, audio.length, BATCH_CHUNKS,
+                                   midiDataPointer, midiSizePointer, ...configArgs);
+    } else if (typeof mod._bp_transcribe === 'function') {
+        mod._bp_transcribe(audioPointer, audio.length, midiDataPointer, midiSizePointer, ...configArgs);
+    } else {
+        mod._convertToMidi(audioPointer, audio.length, midiDataPointer, midiSizePointer, ...configArgs);
+    }
+    const runMs = performance.now() - runStart;
+
+    const midiData = mod.getValue(midiDataPointer, 'i32');
+    const midiSize = mod.getValue(midiSizePointer, 'i32');
+    const header = midiSize >= 4
+        ? String.fromCharCode(...mod.HEAPU8.subarray(midiData, midiData + 4))
+        : '';
+    const ok = header === 'MThd';
+
+    console.log(JSON.stringify({
+        build: path.basename(script),
+        ok,
+        audio_seconds: seconds,
+        midi_bytes: midiSize,
+        load_ms: Math.round(loadMs),
+        init_ms: Math.round(initMs),
+        transcribe_ms: Math.round(runMs),
+        realtime_factor: +(runMs / 1000 / seconds).toFixed(4)
+    }));
+
+    // pthread workers would keep Node alive
+    process.exit(ok ? 0 : 1);
+}
+
+main().catch(err => {
+    console.error(err);
+    process.exit(1);
+});
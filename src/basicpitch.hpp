@@ -4,8 +4,9 @@
 #include <Eigen/Dense>
 #include <cmath>
 #include <complex>
+#include <cstdint>
+#include <functional>
 #include <iostream>
-#include <optional>
 #include <string>
 #include <unsupported/Eigen/CXX11/Tensor>
 #include <vector>
@@ -63,8 +64,21 @@ struct BasicPitchConfig
     float tempo_bpm = constants::MIDI_TEMPO_BPM;
     bool use_melodia_trick = true;
     bool include_pitch_bends = true;
+
+    // Pitch bend thinning before MIDI encoding: drop bends that repeat the
+    // previous value, then, if the tolerance is positive, simplify each
+    // note's bend curve to within that many MIDI bend units (4096 per
+    // semitone)
+    bool simplify_pitch_bends = false;
+    float pitch_bend_tolerance = 0.0f;
+
+    // Threads note extraction may use: 0 for up to one per hardware thread,
+    // 1 to stay on the calling thread (e.g. while inference runs alongside)
+    int postprocess_threads = 0;
 };
 
+class Workspace;
+
 struct InferenceResult
 {
     Eigen::Tensor2dXf notes;
@@ -72,31 +86,144 @@ struct InferenceResult
     Eigen::Tensor2dXf contours;
 };
 
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+// One-off inference with the embedded model; see Engine (engine.hpp) to keep
+// a session around or to load the model from elsewhere
 InferenceResult ort_inference(const std::vector<float> &mono_audio);
 InferenceResult ort_inference(const float *mono_audio, int length);
-InferenceResult ort_inference_with_session(Ort::Session &session, const std::vector<float> &mono_audio);
-InferenceResult ort_inference_with_session(Ort::Session &session, const float *mono_audio, int length);
+#endif
+// With a workspace, the model input is built in its buffers instead of
+// freshly allocated ones
+InferenceResult ort_inference_with_session(Ort::Session &session, const std::vector<float> &mono_audio, Workspace *workspace = nullptr);
+InferenceResult ort_inference_with_session(Ort::Session &session, const float *mono_audio, int length, Workspace *workspace = nullptr);
+
+// Called after each batch with the number of chunks done and in total
+using InferenceProgress = std::function<void(int chunks_done, int n_chunks)>;
+
+// Same as ort_inference_with_session, but runs the model on batch_chunks
+// windows (about 1.7 s of audio each) at a time instead of all at once, so
+// the model's working memory is bounded by the batch size rather than the
+// audio length; only the stitched posteriorgrams grow with it. A
+// batch_chunks of 0 means a single batch.
+InferenceResult ort_inference_in_batches(Ort::Session &session, const float *mono_audio, int length, int batch_chunks, const InferenceProgress &progress = nullptr, Workspace *workspace = nullptr);
+
+// The model runs on overlapping windows ("chunks") of the audio. Number of
+// chunks for length samples, first posteriorgram frame of a chunk, and the
+// samples [begin, end) that chunks [first_chunk, first_chunk + n_chunks)
+// read from a file of total_length samples.
+int ort_num_chunks(int length);
+int ort_chunk_first_frame(int chunk);
+void ort_chunk_samples(int total_length, int first_chunk, int n_chunks, int &begin, int &end);
+
+// Runs the model on chunks [first_chunk, first_chunk + n_chunks) only, given
+// the samples [audio_offset, audio_offset + length) of a file of
+// total_length samples (at least those from ort_chunk_samples), so the
+// chunks of one file can be spread over several sessions, e.g. one per
+// browser worker. The result holds the frames of those chunks, starting at
+// ort_chunk_first_frame(first_chunk); the results of consecutive ranges
+// concatenate to those of ort_inference_in_batches. Progress counts the
+// chunks of the range.
+InferenceResult ort_inference_chunk_range(Ort::Session &session, const float *audio, int length, int audio_offset, int total_length, int first_chunk, int n_chunks, int batch_chunks, const InferenceProgress &progress = nullptr, Workspace *workspace = nullptr);
 
-struct NoteEvent
+// Note events stored as parallel columns (structure of arrays), row i being
+// one note. Pitch bends of all notes share a single arena: note i owns
+// bend_length[i] values starting at bend_offset[i], in contour bins relative
+// to the note pitch; a length of 0 means the note has no pitch bends.
+struct NoteEventTable
 {
-    int start_idx;
-    int end_idx;
-    int pitch;
-    float amplitude;
+    std::vector<int> start_idx;
+    std::vector<int> end_idx;
+    std::vector<int> pitch;
+    std::vector<float> amplitude;
 
-    std::optional<std::vector<int>> pitch_bends;
+    std::vector<uint32_t> bend_offset;
+    std::vector<uint32_t> bend_length;
+    std::vector<int8_t> bends;
+
+    std::size_t size() const { return start_idx.size(); }
+
+    void reserve(std::size_t n)
+    {
+        start_idx.reserve(n);
+        end_idx.reserve(n);
+        pitch.reserve(n);
+        amplitude.reserve(n);
+        bend_offset.reserve(n);
+        bend_length.reserve(n);
+    }
+
+    // empty every column, keeping their capacity
+    void clear()
+    {
+        start_idx.clear();
+        end_idx.clear();
+        pitch.clear();
+        amplitude.clear();
+        bend_offset.clear();
+        bend_length.clear();
+        bends.clear();
+    }
 
-    // comparison operator for sorting
-    bool operator<(const NoteEvent &other) const
+    // append a note without pitch bends
+    void push_back(int start, int end, int note_pitch, float note_amplitude)
     {
-        return std::tie(start_idx, end_idx, pitch, amplitude, pitch_bends) <
-               std::tie(other.start_idx, other.end_idx, other.pitch,
-                        other.amplitude, other.pitch_bends);
+        start_idx.push_back(start);
+        end_idx.push_back(end);
+        pitch.push_back(note_pitch);
+        amplitude.push_back(note_amplitude);
+        bend_offset.push_back(0);
+        bend_length.push_back(0);
     }
+
+    bool has_bends(std::size_t i) const { return bend_length[i] > 0; }
+
+    const int8_t *bends_of(std::size_t i) const
+    {
+        return bends.data() + bend_offset[i];
+    }
+
+    // detach note i from its bends; the arena itself is not compacted
+    void drop_bends(std::size_t i) { bend_length[i] = 0; }
+
+    // reorder rows by (start, end, pitch, amplitude); bends stay in place in
+    // the arena, only their offsets move with the rows
+    void sort();
 };
 
+// Time in seconds of each model frame, compensating for the overlap of the
+// inference windows
+std::vector<float> model_frames_to_time(int n_frames);
+
+// Note events detected in the model output (including pitch bends if
+// enabled), before conversion to MIDI
+NoteEventTable extract_note_events(const InferenceResult &inference_result,
+                                   const BasicPitchConfig &config = BasicPitchConfig{});
+
+// Same, built in workspace.notes from the workspace's scratch buffers; the
+// returned table is valid until the workspace's next job
+NoteEventTable &extract_note_events(const InferenceResult &inference_result,
+                                    const BasicPitchConfig &config,
+                                    Workspace &workspace);
+
 std::vector<uint8_t> convert_to_midi(const InferenceResult &inference_result,
                                      const BasicPitchConfig &config = BasicPitchConfig{});
+
+// Event counts of an encoded MIDI file
+struct MidiEncodeStats
+{
+    std::size_t notes = 0;
+    std::size_t pitch_bends_in = 0;    // one per frame of each bent note
+    std::size_t pitch_bend_events = 0; // written, after simplification
+    double encode_seconds = 0.0;       // note events -> MIDI bytes
+};
+
+// Same as above, appending the MIDI file to a caller-owned buffer so it can
+// be reused across calls; scratch memory comes from workspace if given
+void convert_to_midi(const InferenceResult &inference_result,
+                     const BasicPitchConfig &config,
+                     std::vector<uint8_t> &midi_data,
+                     MidiEncodeStats *stats = nullptr,
+                     Workspace *workspace = nullptr);
 } // namespace basic_pitch
 
 #endif // BASIC_PITCH_HPP
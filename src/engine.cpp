@@ -0,0 +1,127 @@
+#include "engine.hpp"
+
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+// this is the nmp model baked into a header file
+#include "model.ort.h"
+#endif
+
+#ifndef __EMSCRIPTEN__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A read-only mapping of a model file, unmapped when the engine goes away
+struct basic_pitch::Engine::MappedFile
+{
+    const void *data = nullptr;
+    std::size_t size = 0;
+
+#ifndef __EMSCRIPTEN__
+    ~MappedFile()
+    {
+        if (data != nullptr)
+        {
+            munmap(const_cast<void *>(data), size);
+        }
+    }
+#endif
+};
+
+static Ort::SessionOptions make_session_options(int intra_op_threads)
+{
+    Ort::SessionOptions session_options;
+    if (intra_op_threads > 0)
+    {
+        session_options.SetIntraOpNumThreads(intra_op_threads);
+    }
+    return session_options;
+}
+
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+basic_pitch::Engine::Engine(int intra_op_threads)
+    : Engine(model_ort_start, model_ort_size, intra_op_threads)
+{
+}
+#endif
+
+basic_pitch::Engine::Engine(const void *model_data, std::size_t model_size,
+                            int intra_op_threads)
+    // ERROR level suppresses the schema warnings
+    : env_(ORT_LOGGING_LEVEL_ERROR, "basic_pitch")
+{
+    Ort::SessionOptions session_options =
+        make_session_options(intra_op_threads);
+    session_ = std::make_unique<Ort::Session>(env_, model_data, model_size,
+                                              session_options);
+}
+
+basic_pitch::Engine::Engine(std::unique_ptr<MappedFile> mapping,
+                            int intra_op_threads)
+    : env_(ORT_LOGGING_LEVEL_ERROR, "basic_pitch"), mapping_(std::move(mapping))
+{
+    // The mapping lives as long as the session, so ORT can use the model
+    // bytes in place rather than copying them to the heap
+    Ort::SessionOptions session_options =
+        make_session_options(intra_op_threads);
+    session_options.AddConfigEntry("session.use_ort_model_bytes_directly",
+                                   "1");
+    session_ = std::make_unique<Ort::Session>(env_, mapping_->data,
+                                              mapping_->size, session_options);
+}
+
+basic_pitch::Engine::~Engine() = default;
+
+#ifndef __EMSCRIPTEN__
+std::unique_ptr<basic_pitch::Engine>
+basic_pitch::Engine::from_file(const std::string &path, int intra_op_threads)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("unable to open model " + path + ": " +
+                                 std::strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("empty or unreadable model " + path);
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int map_errno = errno;
+    close(fd); // the mapping keeps the file referenced
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("unable to map model " + path + ": " +
+                                 std::strerror(map_errno));
+    }
+
+    auto mapping = std::make_unique<MappedFile>();
+    mapping->data = data;
+    mapping->size = static_cast<std::size_t>(st.st_size);
+    return std::unique_ptr<Engine>(
+        new Engine(std::move(mapping), intra_op_threads));
+}
+#endif
+
+basic_pitch::InferenceResult
+basic_pitch::Engine::infer(const float *mono_audio, int length,
+                           Workspace *workspace)
+{
+    return ort_inference_with_session(*session_, mono_audio, length,
+                                      workspace);
+}
+
+basic_pitch::InferenceResult
+basic_pitch::Engine::infer(const std::vector<float> &mono_audio,
+                           Workspace *workspace)
+{
+    return infer(mono_audio.data(), mono_audio.size(), workspace);
+}
@@ -0,0 +1,66 @@
+#ifndef BASIC_PITCH_ENGINE_HPP
+#define BASIC_PITCH_ENGINE_HPP
+
+#include "basicpitch.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace basic_pitch
+{
+// The ORT environment and a session for the basic-pitch model, kept
+// together so callers can hold one object for as long as they transcribe.
+//
+// By default the model is the copy compiled into the binary
+// (ort-model/model/model.ort.c). It can instead come from an external
+// buffer, e.g. fetched and cached separately on the web, or from a file
+// mapped into memory, so the model can be updated without rebuilding and
+// builds can leave the embedded copy out (BASIC_PITCH_NO_EMBEDDED_MODEL).
+//
+// intra_op_threads sets ORT's intra-op thread count; 0 keeps ORT's default.
+class Engine
+{
+  public:
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+    // Uses the embedded model
+    explicit Engine(int intra_op_threads = 0);
+#endif
+
+    // Uses the ORT-format model in model_data; ORT copies what it needs, so
+    // the buffer may be freed once the constructor returns
+    Engine(const void *model_data, std::size_t model_size,
+           int intra_op_threads = 0);
+
+#ifndef __EMSCRIPTEN__
+    // Maps an ORT-format model file into memory and runs the session from
+    // the mapping without copying it. Throws std::runtime_error if the file
+    // cannot be opened or mapped.
+    static std::unique_ptr<Engine> from_file(const std::string &path,
+                                             int intra_op_threads = 0);
+#endif
+
+    ~Engine();
+
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+
+    Ort::Session &session() { return *session_; }
+
+    InferenceResult infer(const float *mono_audio, int length,
+                          Workspace *workspace = nullptr);
+    InferenceResult infer(const std::vector<float> &mono_audio,
+                          Workspace *workspace = nullptr);
+
+  private:
+    struct MappedFile;
+
+    Engine(std::unique_ptr<MappedFile> mapping, int intra_op_threads);
+
+    Ort::Env env_;
+    // declared before session_ so the mapping outlives the session using it
+    std::unique_ptr<MappedFile> mapping_;
+    std::unique_ptr<Ort::Session> session_;
+};
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_ENGINE_HPP
@@ -0,0 +1,83 @@
+#ifndef BASIC_PITCH_KERNELS_HPP
+#define BASIC_PITCH_KERNELS_HPP
+
+#include "basicpitch.hpp"
+#include <utility>
+#include <vector>
+
+// The individual stages behind ort_inference_* and convert_to_midi, exposed
+// so they can be timed on their own (src_cli/basicpitch_kernel_bench.cpp).
+// Not part of the public API: signatures follow the implementation.
+namespace basic_pitch
+{
+namespace kernels
+{
+// Inclusive range of note bins (0 is MIDI_OFFSET) inside the configured
+// frequency range; empty (first > second) if the range holds no pitch
+std::pair<int, int> note_bin_range(const BasicPitchConfig &config);
+
+// Appends the (time, frequency) onset peaks to peaks
+void find_peaks(const Eigen::Tensor2dXf &onsets, float onset_threshold,
+                int freq_lo, int freq_hi,
+                std::vector<std::pair<int, int>> &peaks);
+
+// Follows each peak, latest first, forward until the note energy stays below
+// frame_threshold, appends the notes longer than min_note_length and clears
+// their energy (and that of the neighbouring bins) in remaining_energy
+void walk_note_energy(const Eigen::Map<const Eigen::MatrixXf> &frames,
+                      Eigen::Map<Eigen::MatrixXf> &remaining_energy,
+                      const std::vector<std::pair<int, int>> &peaks,
+                      float frame_threshold, int min_note_length,
+                      NoteEventTable &note_events);
+
+// Adds notes without an onset peak, starting from the strongest remaining
+// energy and walking both ways in time
+void apply_melodia_trick(Eigen::Map<Eigen::MatrixXf> &remaining_energy,
+                         const Eigen::Map<const Eigen::MatrixXf> &frames,
+                         float frame_thresh, int energy_tol, int min_note_len,
+                         int freq_lo, int freq_hi,
+                         NoteEventTable &note_events);
+
+// Fills the bends of every note from the contours, one per frame, on up to
+// max_threads threads (0: the hardware threads) when there are enough frames
+void add_pitch_bends(const Eigen::Tensor2dXf &contours,
+                     NoteEventTable &note_events, int max_threads = 0);
+
+// Sorts the notes and drops the pitch bends of overlapping ones
+void drop_overlapping_pitch_bends(NoteEventTable &note_events);
+
+// One point of a note's pitch bend curve
+struct BendPoint
+{
+    uint32_t tick;
+    int value; // 14-bit MIDI pitch bend value
+};
+
+// Thins one note's bend curve in place, keeping a point only when it differs
+// by more than tolerance from the value held since the last kept point
+void simplify_pitch_bends(std::vector<BendPoint> &points, float tolerance);
+
+// Appends the MIDI file for note_events to midi_data
+void note_events_to_midi(const NoteEventTable &note_events, int n_times_onsets,
+                         const BasicPitchConfig &config,
+                         std::vector<uint8_t> &midi_data,
+                         MidiEncodeStats *stats, Workspace &ws);
+
+// Chunks [first_chunk, end_chunk) of a file of total_length samples cut into
+// n_chunks_total chunks
+struct ChunkRange
+{
+    int first_chunk;
+    int end_chunk;
+    int n_chunks_total;
+    int total_length;
+};
+
+// Stitches a (chunk, time, freq) model output for the chunks starting at
+// first_chunk into the (time, freq) result for the chunk range
+void unwrap_output(const Ort::Value &output, int first_chunk,
+                   const ChunkRange &range, Eigen::Tensor2dXf &unwrapped);
+} // namespace kernels
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_KERNELS_HPP
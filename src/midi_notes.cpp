@@ -1,32 +1,54 @@
 #include "basicpitch.hpp"
+#include "kernels.hpp"
+#include "midi_writer.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+#include "workspace.hpp"
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
-#include <libremidi/libremidi.hpp>
-#include <libremidi/writer.hpp>
+#include <limits>
 #include <map>
 #include <numeric>
 #include <ranges>
-#include <sstream>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 using namespace basic_pitch::constants;
 
-static std::vector<std::pair<int, int>>
-find_peaks(const Eigen::Tensor2dXf &onsets, float onset_threshold)
+// Convert frequency (Hz) to MIDI pitch
+static float hz_to_midi(float hz)
 {
-    std::vector<std::pair<int, int>> peaks;
+    return 12.0f * std::log2(hz / 440.0f) + 69.0f;
+}
 
+std::pair<int, int>
+basic_pitch::kernels::note_bin_range(const BasicPitchConfig &config)
+{
+    int lo = static_cast<int>(std::round(hz_to_midi(config.min_frequency))) -
+             MIDI_OFFSET;
+    int hi = static_cast<int>(std::round(hz_to_midi(config.max_frequency))) -
+             MIDI_OFFSET;
+    return {std::max(lo, 0), std::min(hi, MAX_FREQ_IDX)};
+}
+
+void basic_pitch::kernels::find_peaks(const Eigen::Tensor2dXf &onsets,
+                                      float onset_threshold, int freq_lo,
+                                      int freq_hi,
+                                      std::vector<std::pair<int, int>> &peaks)
+{
     // Get the dimensions of the onsets tensor
     int n_times = onsets.dimension(0); // Number of time steps (rows)
-    int n_freqs = onsets.dimension(1); // Number of frequency bins (columns)
 
-    // Loop through the tensor to find peaks
+    // Loop through the tensor to find peaks, only over the in-range pitches
     for (int t = 1; t < n_times - 1; ++t)
     {
-        for (int f = 0; f < n_freqs; ++f)
+        for (int f = freq_lo; f <= freq_hi; ++f)
         {
             // Check if the current element is a peak and exceeds the threshold
             if (onsets(t, f) > onset_threshold &&
@@ -38,11 +60,9 @@ find_peaks(const Eigen::Tensor2dXf &onsets, float onset_threshold)
             }
         }
     }
-
-    return peaks;
 }
 
-static std::vector<float> model_frames_to_time(int n_frames)
+std::vector<float> basic_pitch::model_frames_to_time(int n_frames)
 {
     std::vector<float> times(n_frames);
 
@@ -66,22 +86,26 @@ static std::vector<float> model_frames_to_time(int n_frames)
     return times;
 }
 
-static void
-apply_melodia_trick(Eigen::MatrixXf &remaining_energy,
-                    const Eigen::MatrixXf &frames, float frame_thresh,
-                    int energy_tol, int min_note_len,
-                    std::vector<basic_pitch::NoteEvent> &note_events)
+void basic_pitch::kernels::apply_melodia_trick(
+    Eigen::Map<Eigen::MatrixXf> &remaining_energy,
+    const Eigen::Map<const Eigen::MatrixXf> &frames, float frame_thresh,
+    int energy_tol, int min_note_len, int freq_lo, int freq_hi,
+    NoteEventTable &note_events)
 {
 
     int n_times = remaining_energy.rows();
 
+    // only the in-range pitch columns are searched for notes
+    auto in_range = remaining_energy.middleCols(freq_lo, freq_hi - freq_lo + 1);
+
     // Continue applying the trick as long as there is energy above the
     // threshold
-    while (remaining_energy.maxCoeff() > frame_thresh)
+    while (in_range.maxCoeff() > frame_thresh)
     {
         // Find the time-frequency point with maximum remaining energy
         Eigen::Index i_mid, freq_idx;
-        float max_energy = remaining_energy.maxCoeff(&i_mid, &freq_idx);
+        float max_energy = in_range.maxCoeff(&i_mid, &freq_idx);
+        freq_idx += freq_lo;
 
         // Zero out the max energy point
         remaining_energy(i_mid, freq_idx) = 0.0f;
@@ -151,8 +175,8 @@ apply_melodia_trick(Eigen::MatrixXf &remaining_energy,
         amplitude /= (i_end - i_start);
 
         // Store note event (start, end, MIDI pitch, amplitude)
-        note_events.emplace_back(i_start, i_end, freq_idx + MIDI_OFFSET,
-                                 amplitude, std::nullopt);
+        note_events.push_back(i_start, i_end, freq_idx + MIDI_OFFSET,
+                              amplitude);
     }
 }
 
@@ -173,137 +197,258 @@ static float midi_pitch_to_contour_bin(float pitch_midi)
            std::log2(pitch_hz / ANNOTATIONS_BASE_FREQUENCY);
 }
 
-static void add_pitch_bends(const Eigen::Tensor2dXf &contours,
-                            std::vector<basic_pitch::NoteEvent> &note_events,
-                            int n_bins_tolerance = 25)
+// std::exp is not constexpr; range-reduced Taylor series, which rounds to
+// the same floats as std::exp for the window below
+static constexpr double constexpr_exp(double x)
+{
+    int halvings = 0;
+    while (x > 0.5 || x < -0.5)
+    {
+        x /= 2.0;
+        ++halvings;
+    }
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 24; ++n)
+    {
+        term *= x / n;
+        sum += term;
+    }
+    for (int i = 0; i < halvings; ++i)
+    {
+        sum *= sum;
+    }
+    return sum;
+}
+
+constexpr int N_BINS_TOLERANCE = 25;
+constexpr int PITCH_BEND_WINDOW_LENGTH = N_BINS_TOLERANCE * 2 + 1;
+// pitch bend frames a thread must have to pay for starting it
+constexpr std::size_t MIN_FRAMES_PER_THREAD = 8192;
+// frames of one note whose weighted argmax is computed together
+constexpr int PITCH_BEND_BLOCK_FRAMES = 256;
+
+// Gaussian window similar to scipy.signal.windows.gaussian, built at
+// compile time instead of on every call
+static constexpr std::array<float, PITCH_BEND_WINDOW_LENGTH> FREQ_GAUSSIAN =
+    []
+{
+    std::array<float, PITCH_BEND_WINDOW_LENGTH> window{};
+    const float sigma = 5.0f;
+    for (int i = 0; i < PITCH_BEND_WINDOW_LENGTH; ++i)
+    {
+        float x = static_cast<float>(i - N_BINS_TOLERANCE);
+        window[i] =
+            static_cast<float>(constexpr_exp(-(x * x) / (2 * sigma * sigma)));
+    }
+    return window;
+}();
+
+void basic_pitch::kernels::add_pitch_bends(const Eigen::Tensor2dXf &contours,
+                                           NoteEventTable &note_events,
+                                           int max_threads)
 {
+    int n_times = contours.dimension(0);
     int n_freqs_contours = contours.dimension(1);
-    const int window_length = n_bins_tolerance * 2 + 1;
 
-    // Create Gaussian window similar to scipy.signal.windows.gaussian
-    std::vector<float> freq_gaussian(window_length);
-    float sigma = 5.0f;
-    for (int i = 0; i < window_length; ++i)
+    if (note_events.size() == 0)
     {
-        float x = static_cast<float>(i - n_bins_tolerance);
-        freq_gaussian[i] = std::exp(-(x * x) / (2 * sigma * sigma));
+        return;
     }
 
-    for (auto &note_event : note_events)
+    auto contour_bin = [](int pitch_midi)
     {
-        auto &[start_idx, end_idx, pitch_midi, amplitude, pitch_bends] =
-            note_event;
-
-        float bin_float =
-            midi_pitch_to_contour_bin(static_cast<float>(pitch_midi));
-        int freq_idx = static_cast<int>(std::round(bin_float));
-
-        // Ensure frequency indices are within valid bounds
-        int freq_start_idx = std::max(0, freq_idx - n_bins_tolerance);
-        int freq_end_idx =
-            std::min(n_freqs_contours, freq_idx + n_bins_tolerance + 1);
-
-        // Adjust Gaussian window bounds to handle boundary conditions
-        int gaussian_start = std::max(0, n_bins_tolerance - freq_idx);
-        int gaussian_end =
-            window_length -
-            std::max(0, freq_idx - (n_freqs_contours - n_bins_tolerance - 1));
-
-        // Shift factor for calculating relative bends
-        int pb_shift =
-            n_bins_tolerance - std::max(0, n_bins_tolerance - freq_idx);
-
-        // Initialize pitch_bends only if needed
-        pitch_bends
-            .emplace(); // Initializes the std::optional with an empty vector
-        pitch_bends->resize(end_idx -
-                            start_idx); // Resize the vector within the optional
-
-        // Apply Gaussian window and extract submatrix, performing element-wise
-        // multiplication
-        for (int t = start_idx; t < end_idx; ++t)
-        {
-            float max_val = -std::numeric_limits<float>::infinity();
-            int max_idx = 0;
+        return static_cast<int>(std::round(
+            midi_pitch_to_contour_bin(static_cast<float>(pitch_midi))));
+    };
 
-            // Loop within the Gaussian window limits: from `gaussian_start` to
-            // `gaussian_end`
-            for (int f = freq_start_idx, g = gaussian_start;
-                 f < freq_end_idx && g < gaussian_end; ++f, ++g)
+    // Lay out every note's bends back to back in the arena up front (one
+    // value per frame, each fits in int8 as it is within +-N_BINS_TOLERANCE)
+    std::size_t n_notes = note_events.size();
+    std::size_t arena_size = 0;
+    for (std::size_t n = 0; n < n_notes; ++n)
+    {
+        note_events.bend_offset[n] = arena_size;
+        note_events.bend_length[n] =
+            note_events.end_idx[n] - note_events.start_idx[n];
+        arena_size += note_events.bend_length[n];
+    }
+    note_events.bends.resize(arena_size);
+
+    // Notes are independent, so they are split across threads, but only
+    // with enough frames per thread to pay for starting it (a thread costs
+    // about as much as bending a hundred frames); a typical song stays on
+    // the calling thread
+    std::size_t n_threads =
+        std::max<std::size_t>(1, arena_size / MIN_FRAMES_PER_THREAD);
+    if (max_threads > 0)
+    {
+        n_threads = std::min<std::size_t>(n_threads, max_threads);
+    }
+    basic_pitch::parallel_for(
+        n_notes,
+        [&](std::size_t n)
+        {
+            int start_idx = note_events.start_idx[n];
+            int end_idx = note_events.end_idx[n];
+            int pitch_midi = note_events.pitch[n];
+            int8_t *pitch_bends =
+                note_events.bends.data() + note_events.bend_offset[n];
+
+            int freq_idx = contour_bin(pitch_midi);
+
+            // Ensure frequency indices are within valid bounds
+            int freq_start_idx = std::max(0, freq_idx - N_BINS_TOLERANCE);
+            int freq_end_idx =
+                std::min(n_freqs_contours, freq_idx + N_BINS_TOLERANCE + 1);
+
+            // Adjust Gaussian window bounds to handle boundary conditions
+            int gaussian_start = std::max(0, N_BINS_TOLERANCE - freq_idx);
+            int gaussian_end =
+                PITCH_BEND_WINDOW_LENGTH -
+                std::max(0, freq_idx - (n_freqs_contours - N_BINS_TOLERANCE -
+                                        1));
+            int window_len = std::min(freq_end_idx - freq_start_idx,
+                                      gaussian_end - gaussian_start);
+
+            // Shift factor for calculating relative bends
+            int pb_shift =
+                N_BINS_TOLERANCE - std::max(0, N_BINS_TOLERANCE - freq_idx);
+
+            const float *window = FREQ_GAUSSIAN.data() + gaussian_start;
+
+            // The tensor is column-major, so each bin of the note's window is
+            // a contiguous run of frames: read it in place, a block of frames
+            // at a time, keeping the weighted max and its first bin per
+            // frame (same as a strict '>' scan across the window)
+            const float *note_bins =
+                contours.data() +
+                static_cast<Eigen::Index>(freq_start_idx) * n_times;
+            std::array<float, PITCH_BEND_BLOCK_FRAMES> max_val;
+            std::array<int, PITCH_BEND_BLOCK_FRAMES> max_bin;
+
+            for (int block = start_idx; block < end_idx;
+                 block += PITCH_BEND_BLOCK_FRAMES)
             {
-                // Apply Gaussian window to each frequency bin in the current
-                // frame
-                float weighted_value = contours(t, f) * freq_gaussian[g];
-                if (weighted_value > max_val)
+                int len = std::min(PITCH_BEND_BLOCK_FRAMES, end_idx - block);
+
+                const float *bin_frames = note_bins + block;
+                for (int i = 0; i < len; ++i)
                 {
-                    max_val = weighted_value;
-                    max_idx = f; // Store the actual frequency bin index
+                    max_val[i] = bin_frames[i] * window[0];
+                    max_bin[i] = 0;
+                }
+                for (int bin = 1; bin < window_len; ++bin)
+                {
+                    bin_frames = note_bins +
+                                 static_cast<Eigen::Index>(bin) * n_times +
+                                 block;
+                    for (int i = 0; i < len; ++i)
+                    {
+                        float weighted = bin_frames[i] * window[bin];
+                        if (weighted > max_val[i])
+                        {
+                            max_val[i] = weighted;
+                            max_bin[i] = bin;
+                        }
+                    }
+                }
+
+                // Normalize the max index relative to the Gaussian window
+                // center
+                for (int i = 0; i < len; ++i)
+                {
+                    pitch_bends[block - start_idx + i] =
+                        static_cast<int8_t>(max_bin[i] - pb_shift);
                 }
             }
+        },
+        16, n_threads);
+}
 
-            // Normalize the max index relative to the Gaussian window center
-            (*pitch_bends)[t - start_idx] =
-                (max_idx - freq_start_idx) - pb_shift;
+void basic_pitch::NoteEventTable::sort()
+{
+    // Sort a permutation on the scalar keys, then gather every column once
+    std::vector<uint32_t> order(size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [this](uint32_t a, uint32_t b)
+              {
+                  return std::tie(start_idx[a], end_idx[a], pitch[a],
+                                  amplitude[a]) < std::tie(start_idx[b],
+                                                           end_idx[b], pitch[b],
+                                                           amplitude[b]);
+              });
+
+    auto gather = [&order](auto &column)
+    {
+        std::remove_reference_t<decltype(column)> sorted(column.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            sorted[i] = column[order[i]];
         }
-    }
+        column.swap(sorted);
+    };
+    gather(start_idx);
+    gather(end_idx);
+    gather(pitch);
+    gather(amplitude);
+    gather(bend_offset);
+    gather(bend_length);
 }
 
-// Function to drop pitch bends from overlapping notes
-static void
-drop_overlapping_pitch_bends(std::vector<basic_pitch::NoteEvent> &note_events)
+void basic_pitch::kernels::drop_overlapping_pitch_bends(
+    NoteEventTable &note_events)
 {
-    // Sort by start time
-    std::sort(note_events.begin(), note_events.end());
-
-    for (size_t i = 0; i < note_events.size() - 1; ++i)
+    note_events.sort();
+
+    // Sweep in start order, tracking the furthest end seen so far. A note
+    // overlaps an earlier one iff it starts before that end. Any note that
+    // keeps its bends must not overlap anything before it, so at most one
+    // earlier note (the latest such one) can still lose its bends to the
+    // current note; everything else is already dropped. That makes the sweep
+    // linear after the O(n log n) sort.
+    int max_end = std::numeric_limits<int>::min();
+    std::ptrdiff_t candidate = -1;
+
+    for (std::size_t i = 0; i < note_events.size(); ++i)
     {
-        for (size_t j = i + 1; j < note_events.size(); ++j)
+        int start_idx = note_events.start_idx[i];
+        if (start_idx < max_end)
         {
-            // Check if start time of note j is after end time of note i
-            if ((note_events[j].start_idx) >= (note_events[i].end_idx))
+            if (candidate >= 0 && note_events.end_idx[candidate] > start_idx)
             {
-                break; // No overlap
+                note_events.drop_bends(candidate);
             }
-
-            // Remove pitch bends from overlapping notes
-            note_events[i].pitch_bends = std::nullopt;
-            note_events[j].pitch_bends = std::nullopt;
+            candidate = -1;
+            note_events.drop_bends(i);
+        }
+        else
+        {
+            candidate = i;
         }
+
+        max_end = std::max(max_end, note_events.end_idx[i]);
     }
 }
 
-// Main function to convert frames and onsets to note events
-static std::vector<basic_pitch::NoteEvent>
-output_to_notes_polyphonic(const basic_pitch::InferenceResult &inference_result,
-                           const basic_pitch::BasicPitchConfig &config)
+void basic_pitch::kernels::walk_note_energy(
+    const Eigen::Map<const Eigen::MatrixXf> &frames,
+    Eigen::Map<Eigen::MatrixXf> &remaining_energy,
+    const std::vector<std::pair<int, int>> &peaks, float frame_threshold,
+    int min_note_length, NoteEventTable &note_events)
 {
+    int n_times = frames.rows();
 
-    int n_times_onsets = inference_result.onsets.dimension(0);
-
-    Eigen::Tensor2dXf frames = inference_result.notes;
-
-    Eigen::Tensor2dXf remaining_energy =
-        frames; // Clone frames as we will modify this in-place
-    std::vector<basic_pitch::NoteEvent> note_events;
-
-    // Find peaks in the onsets
-    auto peaks = find_peaks(inference_result.onsets, config.onset_threshold);
-
-    // reverse sort the peaks by onset value
-    // std::sort(filtered_peaks.begin(), filtered_peaks.end(),
-    // std::greater<>());
-    std::reverse(peaks.begin(), peaks.end());
-
-    // Process peaks to generate note events
     for (const auto &[note_start_idx, freq_idx] : peaks)
     {
         int i = note_start_idx + 1;
         int k = 0;
 
         // Find the point where the note energy drops below the threshold
-        while (i < n_times_onsets - 1 && k < ENERGY_TOL)
+        while (i < n_times - 1 && k < ENERGY_TOL)
         {
-            if (remaining_energy(i, freq_idx) < config.frame_threshold)
+            if (remaining_energy(i, freq_idx) < frame_threshold)
             {
                 k++;
             }
@@ -315,7 +460,7 @@ output_to_notes_polyphonic(const basic_pitch::InferenceResult &inference_result,
         }
         i -= k; // Adjust index
 
-        if (i - note_start_idx <= config.min_note_length)
+        if (i - note_start_idx <= min_note_length)
             continue; // Skip short notes
 
         // Clear energy in the current frequency band
@@ -336,27 +481,77 @@ output_to_notes_polyphonic(const basic_pitch::InferenceResult &inference_result,
         }
         amplitude /= (i - note_start_idx);
 
-        note_events.emplace_back(note_start_idx, i, freq_idx + MIDI_OFFSET,
-                                 amplitude, std::nullopt);
+        note_events.push_back(note_start_idx, i, freq_idx + MIDI_OFFSET,
+                              amplitude);
+    }
+}
+
+// Main function to convert frames and onsets to note events
+//
+// The inference output is only read through a view; the remaining energy,
+// the peaks and note_events itself live in the workspace's buffers
+static void
+output_to_notes_polyphonic(const basic_pitch::InferenceResult &inference_result,
+                           const basic_pitch::BasicPitchConfig &config,
+                           basic_pitch::Workspace &ws,
+                           basic_pitch::NoteEventTable &note_events)
+{
+    const Eigen::Map<const Eigen::MatrixXf> frames(
+        inference_result.notes.data(), inference_result.notes.dimension(0),
+        inference_result.notes.dimension(1));
+
+    // Clone frames as we will modify this in-place
+    Eigen::Map<Eigen::MatrixXf> remaining_energy(
+        ws.use(ws.energy, frames.size()), frames.rows(), frames.cols());
+    remaining_energy = frames;
+
+    // Notes are only looked for within the configured frequency range
+    auto [freq_lo, freq_hi] = basic_pitch::kernels::note_bin_range(config);
+    if (freq_lo > freq_hi)
+    {
+        return;
+    }
+
+    // Find peaks in the onsets
+    std::vector<std::pair<int, int>> &peaks = ws.peaks;
+    std::size_t peaks_capacity = ws.begin_append(peaks);
+    {
+        BP_TRACE_SCOPE("peak picking");
+        basic_pitch::kernels::find_peaks(inference_result.onsets,
+                                         config.onset_threshold, freq_lo,
+                                         freq_hi, peaks);
+    }
+    ws.used(peaks, peaks_capacity);
+
+    // reverse sort the peaks by onset value
+    // std::sort(filtered_peaks.begin(), filtered_peaks.end(),
+    // std::greater<>());
+    std::reverse(peaks.begin(), peaks.end());
+    note_events.reserve(peaks.size());
+
+    // Process peaks to generate note events
+    {
+        BP_TRACE_SCOPE("energy walk");
+        basic_pitch::kernels::walk_note_energy(
+            frames, remaining_energy, peaks, config.frame_threshold,
+            config.min_note_length, note_events);
     }
 
     if (config.use_melodia_trick)
     {
-        // get matrixxf of remaining_energy, frames to apply melodia trick
-        Eigen::MatrixXf remaining_energy_mat = Eigen::Map<Eigen::MatrixXf>(
-            remaining_energy.data(), remaining_energy.dimension(0),
-            remaining_energy.dimension(1));
-        Eigen::MatrixXf frames_mat = Eigen::Map<Eigen::MatrixXf>(
-            frames.data(), frames.dimension(0), frames.dimension(1));
-        apply_melodia_trick(remaining_energy_mat, frames_mat, config.frame_threshold,
-                            ENERGY_TOL, config.min_note_length, note_events);
+        BP_TRACE_SCOPE("melodia");
+        basic_pitch::kernels::apply_melodia_trick(
+            remaining_energy, frames, config.frame_threshold, ENERGY_TOL,
+            config.min_note_length, freq_lo, freq_hi, note_events);
     }
 
     if (config.include_pitch_bends)
     {
-        add_pitch_bends(inference_result.contours, note_events);
+        BP_TRACE_SCOPE("pitch bends");
+        basic_pitch::kernels::add_pitch_bends(inference_result.contours,
+                                              note_events,
+                                              config.postprocess_threads);
     }
-    return note_events;
 }
 
 static uint32_t time_to_ticks(float time_seconds, int tempo_us,
@@ -366,56 +561,89 @@ static uint32_t time_to_ticks(float time_seconds, int tempo_us,
         std::round((time_seconds * tpqn * 1'000'000) / tempo_us));
 }
 
-static libremidi::writer
-note_events_to_midi(const std::vector<basic_pitch::NoteEvent> &note_events,
-                    int n_times_onsets)
-{
+// channel message status bytes (channel 0)
+constexpr uint8_t NOTE_OFF = 0x80;
+constexpr uint8_t NOTE_ON = 0x90;
+constexpr uint8_t PROGRAM_CHANGE = 0xC0;
+constexpr uint8_t PITCH_BEND = 0xE0;
 
-    libremidi::writer midi_writer;
-    midi_writer.ticksPerQuarterNote = DEFAULT_TPQN;
+// meta event types
+constexpr uint8_t META_TEMPO = 0x51;
+constexpr uint8_t META_TIME_SIGNATURE = 0x58;
 
-    // Track with tempo and time signature
-    libremidi::midi_track meta_track;
-    meta_track.emplace_back(0, 0, libremidi::meta_events::tempo(MIDI_TEMPO_US));
-    meta_track.emplace_back(
-        0, 0,
-        libremidi::meta_events::time_signature(TIME_SIGNATURE_NUMERATOR,
-                                               TIME_SIGNATURE_DENOMINATOR));
-    midi_writer.tracks.push_back(meta_track);
+void basic_pitch::kernels::simplify_pitch_bends(
+    std::vector<BendPoint> &points, float tolerance)
+{
+    if (points.empty())
+    {
+        return;
+    }
 
+    // A bend holds its value until the next one, so a point can only be
+    // dropped if the value held from the last kept point is close enough.
+    // With a zero tolerance this only drops repeats of the previous value.
+    std::size_t n_kept = 1;
+    int held = points.front().value;
+    for (std::size_t i = 1; i < points.size(); ++i)
+    {
+        if (std::abs(points[i].value - held) > tolerance)
+        {
+            held = points[i].value;
+            points[n_kept++] = points[i];
+        }
+    }
+    points.resize(n_kept);
+}
+
+void basic_pitch::kernels::note_events_to_midi(
+    const NoteEventTable &note_events, int n_times_onsets,
+    const BasicPitchConfig &config, std::vector<uint8_t> &midi_data,
+    MidiEncodeStats *stats, Workspace &ws)
+{
     // Calculate frame times for each note onset
-    std::vector<float> frame_times = model_frames_to_time(n_times_onsets);
+    std::vector<float> frame_times =
+        basic_pitch::model_frames_to_time(n_times_onsets);
+
+    // All events with their absolute tick times
+    std::vector<basic_pitch::TimedMidiEvent> &midi_events = ws.midi_events;
+    std::size_t events_capacity = ws.begin_append(midi_events);
+
+    // Every note has an on and an off event, plus one event per bend
+    midi_events.reserve(2 * note_events.size() + note_events.bends.size());
 
-    // Create a vector to hold all events with their absolute tick times
-    struct MidiEvent
+    auto bend_point = [](uint32_t tick, int bend)
     {
-        uint32_t tick; // Absolute tick time
-        libremidi::message message;
+        int bend_value = bend * (4096 / CONTOURS_BINS_PER_SEMITONE) + 8192;
+        return BendPoint{tick, std::clamp(bend_value, 0, 16383)};
     };
 
-    std::vector<MidiEvent> midi_events;
-
-    std::cout << "Before iterating over note events" << std::endl;
+    // one note's bend curve, reused across notes
+    std::vector<BendPoint> bend_points;
+    std::size_t n_bends_in = 0;
 
     // Iterate over note events
-    for (const auto &[start_idx, end_idx, pitch, amplitude, pitch_bend_opt] :
-         note_events)
+    for (std::size_t n = 0; n < note_events.size(); ++n)
     {
+        int start_idx = note_events.start_idx[n];
+        int end_idx = note_events.end_idx[n];
+        uint8_t pitch = note_events.pitch[n];
+        float amplitude = note_events.amplitude[n];
+
         float start_time = frame_times[start_idx];
         float end_time = frame_times[end_idx];
         uint32_t start_tick = time_to_ticks(start_time, MIDI_TEMPO_US);
         uint32_t end_tick = time_to_ticks(end_time, MIDI_TEMPO_US);
-        int velocity = static_cast<int>(amplitude * 127);
+        uint8_t velocity = static_cast<int>(amplitude * 127);
 
         // Add `Note_on` event at start_tick
-        midi_events.push_back({start_tick, libremidi::channel_events::note_on(
-                                               0, pitch, velocity)});
+        midi_events.push_back({start_tick, NOTE_ON, pitch, velocity});
 
         // Process pitch bends directly without allocating a sub-vector
-        if (pitch_bend_opt.has_value())
+        if (note_events.has_bends(n))
         {
-            const std::vector<int> &pitch_bend = pitch_bend_opt.value();
-            int num_bends = pitch_bend.size();
+            const int8_t *pitch_bend = note_events.bends_of(n);
+            int num_bends = note_events.bend_length[n];
+            bend_points.clear();
 
             if (num_bends > 1)
             {
@@ -431,42 +659,47 @@ note_events_to_midi(const std::vector<basic_pitch::NoteEvent> &note_events,
                     // Ensure bend_tick does not exceed end_tick
                     bend_tick = std::min(bend_tick, end_tick);
 
-                    int bend_value =
-                        pitch_bend[i] * (4096 / CONTOURS_BINS_PER_SEMITONE) +
-                        8192;
-                    bend_value = std::clamp(bend_value, 0, 16383);
-
-                    // Add pitch bend event at bend_tick
-                    midi_events.push_back(
-                        {bend_tick,
-                         libremidi::channel_events::pitch_bend(0, bend_value)});
+                    bend_points.push_back(bend_point(bend_tick, pitch_bend[i]));
                 }
             }
             else
             {
-                // Single pitch bend case
-                uint32_t bend_tick = start_tick;
-                int bend_value =
-                    pitch_bend[0] * (4096 / CONTOURS_BINS_PER_SEMITONE) + 8192;
-                bend_value = std::clamp(bend_value, 0, 16383);
+                // Single pitch bend case, at start_tick
+                bend_points.push_back(bend_point(start_tick, pitch_bend[0]));
+            }
+
+            n_bends_in += bend_points.size();
+            if (config.simplify_pitch_bends)
+            {
+                basic_pitch::kernels::simplify_pitch_bends(
+                    bend_points, config.pitch_bend_tolerance);
+            }
 
-                // Add pitch bend event at start_tick
+            for (const auto &[bend_tick, bend_value] : bend_points)
+            {
                 midi_events.push_back(
-                    {bend_tick,
-                     libremidi::channel_events::pitch_bend(0, bend_value)});
+                    {bend_tick, PITCH_BEND,
+                     static_cast<uint8_t>(bend_value & 0x7F),
+                     static_cast<uint8_t>((bend_value >> 7) & 0x7F)});
             }
         }
 
         // Add `Note_off` event at end_tick
-        midi_events.push_back(
-            {end_tick, libremidi::channel_events::note_off(0, pitch, 0)});
+        midi_events.push_back({end_tick, NOTE_OFF, pitch, 0});
     }
 
-    std::cout << "After iterating over note events" << std::endl;
+    if (stats)
+    {
+        stats->notes = note_events.size();
+        stats->pitch_bends_in = n_bends_in;
+        stats->pitch_bend_events =
+            midi_events.size() - 2 * note_events.size();
+    }
 
     // Sort all events by their absolute tick times
     std::sort(midi_events.begin(), midi_events.end(),
-              [](const MidiEvent &a, const MidiEvent &b)
+              [](const basic_pitch::TimedMidiEvent &a,
+                 const basic_pitch::TimedMidiEvent &b)
               {
                   if (a.tick != b.tick)
                   {
@@ -475,69 +708,116 @@ note_events_to_midi(const std::vector<basic_pitch::NoteEvent> &note_events,
                   else
                   {
                       // Secondary sorting by message type
-                      return a.message.get_message_type() <
-                             b.message.get_message_type();
+                      return (a.status & 0xF0) < (b.status & 0xF0);
                   }
               });
 
-    std::cout << "Now creating instrument track" << std::endl;
+    ws.used(midi_events, events_capacity);
+
+    // Upper bound of the file size: headers and the tempo track, then at
+    // most a 4 byte delta and 3 message bytes per event
+    midi_data.reserve(midi_data.size() + 64 + 7 * (midi_events.size() + 1));
+
+    basic_pitch::MidiWriter writer(midi_data);
+    writer.header(1, 2, DEFAULT_TPQN);
+
+    // Track with tempo and time signature
+    const uint8_t tempo[] = {static_cast<uint8_t>(MIDI_TEMPO_US >> 16),
+                             static_cast<uint8_t>(MIDI_TEMPO_US >> 8),
+                             static_cast<uint8_t>(MIDI_TEMPO_US)};
+    const uint8_t time_signature[] = {
+        TIME_SIGNATURE_NUMERATOR,
+        static_cast<uint8_t>(std::countr_zero(
+            static_cast<unsigned>(TIME_SIGNATURE_DENOMINATOR))),
+        // clocks per click and 32nd notes per quarter note as libremidi
+        // (ModernMIDI) writes them, which the output has to match
+        1, 96};
+    writer.begin_track();
+    writer.meta_event(0, META_TEMPO, tempo, sizeof(tempo));
+    writer.meta_event(0, META_TIME_SIGNATURE, time_signature,
+                      sizeof(time_signature));
+    writer.end_track();
 
     // Now, compute delta times and add events to the instrument track
-    libremidi::midi_track instrument_track;
-    instrument_track.emplace_back(0, 0,
-                                  libremidi::channel_events::program_change(
-                                      0, 4)); // Set program to Electric Piano
+    writer.begin_track();
+    writer.channel_event(0, PROGRAM_CHANGE, 4); // Set program to Electric Piano
 
     uint32_t last_tick = 0;
     for (const auto &event : midi_events)
     {
         uint32_t delta_ticks = event.tick - last_tick;
-        instrument_track.emplace_back(delta_ticks, 0, event.message);
+        writer.channel_event(delta_ticks, event.status, event.data1,
+                             event.data2);
         last_tick = event.tick;
     }
-
-    midi_writer.tracks.push_back(instrument_track);
-    return midi_writer;
+    writer.end_track();
 }
 
-std::vector<uint8_t> basic_pitch::convert_to_midi(
+basic_pitch::NoteEventTable &basic_pitch::extract_note_events(
     const basic_pitch::InferenceResult &inference_result,
-    const BasicPitchConfig &config
-)
+    const BasicPitchConfig &config, Workspace &workspace)
 {
-    // Process the unwrapped notes and onsets to detect note events
-
-    std::cout << "output_to_notes_polyphonic" << std::endl;
-
-    std::vector<basic_pitch::NoteEvent> note_events =
-        output_to_notes_polyphonic(inference_result, config);
+    BP_TRACE_SCOPE("note extraction");
+    NoteEventTable &note_events = workspace.notes;
+    std::size_t notes_capacity = workspace.begin_append(note_events);
+    output_to_notes_polyphonic(inference_result, config, workspace,
+                               note_events);
 
     if (config.include_pitch_bends)
     {
         // Drop pitch bends from overlapping notes
-        drop_overlapping_pitch_bends(note_events);
+        BP_TRACE_SCOPE("drop overlapping bends");
+        basic_pitch::kernels::drop_overlapping_pitch_bends(note_events);
     }
+    workspace.used(note_events, notes_capacity);
+    return note_events;
+}
 
-    int n_times_notes = inference_result.notes.dimension(0);
-
-    std::cout << "note_events_to_midi" << std::endl;
-
-    // Convert the detected note events to a MIDI writer object
-    libremidi::writer midi_writer =
-        note_events_to_midi(note_events, n_times_notes);
+basic_pitch::NoteEventTable basic_pitch::extract_note_events(
+    const basic_pitch::InferenceResult &inference_result,
+    const BasicPitchConfig &config)
+{
+    Workspace workspace;
+    extract_note_events(inference_result, config, workspace);
+    return std::move(workspace.notes);
+}
 
-    std::cout << "done!" << std::endl;
+void basic_pitch::convert_to_midi(
+    const basic_pitch::InferenceResult &inference_result,
+    const BasicPitchConfig &config, std::vector<uint8_t> &midi_data,
+    MidiEncodeStats *stats, Workspace *workspace)
+{
+    Workspace local_workspace;
+    Workspace &ws = workspace ? *workspace : local_workspace;
 
-    // Use ostringstream to write MIDI data to a byte stream
-    std::ostringstream output(std::ios::binary);
-    midi_writer.write(output);
+    // Process the unwrapped notes and onsets to detect note events
+    const basic_pitch::NoteEventTable &note_events =
+        extract_note_events(inference_result, config, ws);
 
-    // Convert the byte stream to a string
-    std::string midi_string = output.str();
+    int n_times_notes = inference_result.notes.dimension(0);
 
-    // Create a vector to hold the MIDI data
-    std::vector<uint8_t> midi_data(midi_string.begin(), midi_string.end());
+    // Encode the detected note events straight into the MIDI byte buffer
+    auto encode_start = std::chrono::steady_clock::now();
+    {
+        BP_TRACE_SCOPE("MIDI encode");
+        basic_pitch::kernels::note_events_to_midi(
+            note_events, n_times_notes, config, midi_data, stats, ws);
+    }
+    if (stats)
+    {
+        stats->encode_seconds = std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() -
+                                    encode_start)
+                                    .count();
+    }
+}
 
-    // Return the MIDI data as bytes
+std::vector<uint8_t> basic_pitch::convert_to_midi(
+    const basic_pitch::InferenceResult &inference_result,
+    const BasicPitchConfig &config
+)
+{
+    std::vector<uint8_t> midi_data;
+    convert_to_midi(inference_result, config, midi_data);
     return midi_data;
 }
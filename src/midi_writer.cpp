@@ -0,0 +1,93 @@
+#include "midi_writer.hpp"
+
+void basic_pitch::MidiWriter::header(uint16_t format, uint16_t n_tracks,
+                                     uint16_t ticks_per_quarter)
+{
+    out_.insert(out_.end(), {'M', 'T', 'h', 'd'});
+    write_be(6, 4);
+    write_be(format, 2);
+    write_be(n_tracks, 2);
+    write_be(ticks_per_quarter, 2);
+}
+
+void basic_pitch::MidiWriter::begin_track()
+{
+    out_.insert(out_.end(), {'M', 'T', 'r', 'k'});
+    write_be(0, 4);
+    track_start_ = out_.size();
+    last_status_ = 0;
+}
+
+void basic_pitch::MidiWriter::channel_event(uint32_t delta, uint8_t status,
+                                            uint8_t data1)
+{
+    write_varint(delta);
+    write_status(status);
+    out_.push_back(data1);
+}
+
+void basic_pitch::MidiWriter::channel_event(uint32_t delta, uint8_t status,
+                                            uint8_t data1, uint8_t data2)
+{
+    write_varint(delta);
+    write_status(status);
+    out_.insert(out_.end(), {data1, data2});
+}
+
+void basic_pitch::MidiWriter::meta_event(uint32_t delta, uint8_t type,
+                                         const uint8_t *data,
+                                         std::size_t length)
+{
+    write_varint(delta);
+    out_.insert(out_.end(), {0xFF, type});
+    write_varint(length);
+    out_.insert(out_.end(), data, data + length);
+
+    // meta events cancel running status
+    last_status_ = 0;
+}
+
+void basic_pitch::MidiWriter::end_track()
+{
+    meta_event(0, 0x2F, nullptr, 0);
+
+    uint32_t length = out_.size() - track_start_;
+    for (int i = 0; i < 4; ++i)
+    {
+        out_[track_start_ - 4 + i] = (length >> (8 * (3 - i))) & 0xFF;
+    }
+}
+
+void basic_pitch::MidiWriter::write_status(uint8_t status)
+{
+    if (!running_status_ || status != last_status_)
+    {
+        out_.push_back(status);
+    }
+    last_status_ = status;
+}
+
+void basic_pitch::MidiWriter::write_varint(uint32_t value)
+{
+    // 7 bits per byte, most significant group first, high bit set on all
+    // but the last byte
+    uint8_t buffer[5];
+    int n = 0;
+    buffer[n++] = value & 0x7F;
+    while (value >>= 7)
+    {
+        buffer[n++] = 0x80 | (value & 0x7F);
+    }
+    while (n > 0)
+    {
+        out_.push_back(buffer[--n]);
+    }
+}
+
+void basic_pitch::MidiWriter::write_be(uint32_t value, int n_bytes)
+{
+    for (int i = n_bytes - 1; i >= 0; --i)
+    {
+        out_.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
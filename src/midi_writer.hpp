@@ -0,0 +1,68 @@
+#ifndef BASIC_PITCH_MIDI_WRITER_HPP
+#define BASIC_PITCH_MIDI_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace basic_pitch
+{
+// Channel message at an absolute tick, before delta-time encoding
+struct TimedMidiEvent
+{
+    uint32_t tick;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+// Standard MIDI File encoder appending straight into a caller-supplied byte
+// buffer: no per-event objects and no intermediate stream.
+//
+//   MidiWriter writer(bytes);
+//   writer.header(1, 2, DEFAULT_TPQN);
+//   writer.begin_track();
+//   writer.channel_event(delta, 0x90, pitch, velocity);
+//   writer.end_track();
+//
+// Running status (omitting a repeated status byte) is off by default so the
+// output matches what other writers produce byte for byte.
+class MidiWriter
+{
+  public:
+    explicit MidiWriter(std::vector<uint8_t> &out, bool running_status = false)
+        : out_(out), running_status_(running_status)
+    {
+    }
+
+    void header(uint16_t format, uint16_t n_tracks, uint16_t ticks_per_quarter);
+
+    // writes the "MTrk" chunk header; its length is patched in end_track()
+    void begin_track();
+
+    // two-byte channel message (program change, channel pressure)
+    void channel_event(uint32_t delta, uint8_t status, uint8_t data1);
+
+    // three-byte channel message (note on/off, pitch bend, ...)
+    void channel_event(uint32_t delta, uint8_t status, uint8_t data1,
+                       uint8_t data2);
+
+    void meta_event(uint32_t delta, uint8_t type, const uint8_t *data,
+                    std::size_t length);
+
+    // appends the end-of-track meta event and fills in the chunk length
+    void end_track();
+
+  private:
+    void write_status(uint8_t status);
+    void write_varint(uint32_t value);
+    void write_be(uint32_t value, int n_bytes);
+
+    std::vector<uint8_t> &out_;
+    bool running_status_;
+    uint8_t last_status_ = 0;
+    std::size_t track_start_ = 0;
+};
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_MIDI_WRITER_HPP
@@ -0,0 +1,240 @@
+#include "note_formats.hpp"
+#include "trace.hpp"
+#include "workspace.hpp"
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little,
+              "the binary note format is written in host byte order");
+
+namespace
+{
+void append(std::vector<uint8_t> &out, const char *text)
+{
+    out.insert(out.end(), text, text + std::strlen(text));
+}
+
+template <typename T> void append_number(std::vector<uint8_t> &out, T value)
+{
+    // shortest representation that round-trips, no locale involved
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.insert(out.end(), buffer, result.ptr);
+}
+
+template <typename T> void append_raw(std::vector<uint8_t> &out, const T &value)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+uint8_t note_velocity(float amplitude)
+{
+    return static_cast<int>(amplitude * 127);
+}
+} // namespace
+
+bool basic_pitch::parse_output_format(const std::string &name,
+                                      OutputFormat &format)
+{
+    if (name == "midi" || name == "mid")
+    {
+        format = OutputFormat::MIDI;
+    }
+    else if (name == "bin" || name == "bpn")
+    {
+        format = OutputFormat::NOTES_BINARY;
+    }
+    else if (name == "csv")
+    {
+        format = OutputFormat::CSV;
+    }
+    else if (name == "jsonl")
+    {
+        format = OutputFormat::JSONL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char *basic_pitch::output_format_extension(OutputFormat format)
+{
+    switch (format)
+    {
+    case OutputFormat::NOTES_BINARY:
+        return ".bpn";
+    case OutputFormat::CSV:
+        return ".csv";
+    case OutputFormat::JSONL:
+        return ".jsonl";
+    case OutputFormat::MIDI:
+    default:
+        return ".mid";
+    }
+}
+
+void basic_pitch::write_notes_binary(const NoteEventTable &note_events,
+                                     int n_frames, std::vector<uint8_t> &out)
+{
+    std::vector<float> frame_times = model_frames_to_time(n_frames);
+
+    uint32_t bend_count = 0;
+    for (std::size_t n = 0; n < note_events.size(); ++n)
+    {
+        bend_count += note_events.bend_length[n];
+    }
+
+    out.reserve(out.size() + sizeof(NoteFileHeader) +
+                note_events.size() * sizeof(NoteRecord) + bend_count);
+
+    NoteFileHeader header{{'B', 'P', 'N', 'T'},
+                          NOTE_FILE_VERSION,
+                          sizeof(NoteRecord),
+                          static_cast<uint32_t>(note_events.size()),
+                          bend_count};
+    append_raw(out, header);
+
+    // the arena may hold bends of notes that have since dropped them, so
+    // offsets are recomputed for the compacted copy written below
+    uint32_t bend_offset = 0;
+    for (std::size_t n = 0; n < note_events.size(); ++n)
+    {
+        NoteRecord record{frame_times[note_events.start_idx[n]],
+                          frame_times[note_events.end_idx[n]],
+                          note_events.amplitude[n],
+                          bend_offset,
+                          note_events.bend_length[n],
+                          static_cast<uint8_t>(note_events.pitch[n]),
+                          note_velocity(note_events.amplitude[n]),
+                          {0, 0}};
+        append_raw(out, record);
+        bend_offset += note_events.bend_length[n];
+    }
+
+    for (std::size_t n = 0; n < note_events.size(); ++n)
+    {
+        if (note_events.has_bends(n))
+        {
+            const int8_t *bends = note_events.bends_of(n);
+            out.insert(out.end(), bends, bends + note_events.bend_length[n]);
+        }
+    }
+}
+
+void basic_pitch::write_notes_csv(const NoteEventTable &note_events,
+                                  int n_frames, std::vector<uint8_t> &out)
+{
+    std::vector<float> frame_times = model_frames_to_time(n_frames);
+
+    append(out, "start_time_s,end_time_s,pitch_midi,velocity,pitch_bend\n");
+    for (std::size_t n = 0; n < note_events.size(); ++n)
+    {
+        append_number(out, frame_times[note_events.start_idx[n]]);
+        out.push_back(',');
+        append_number(out, frame_times[note_events.end_idx[n]]);
+        out.push_back(',');
+        append_number(out, note_events.pitch[n]);
+        out.push_back(',');
+        append_number(out, static_cast<int>(
+                               note_velocity(note_events.amplitude[n])));
+
+        const int8_t *bends = note_events.bends_of(n);
+        for (uint32_t i = 0; i < note_events.bend_length[n]; ++i)
+        {
+            out.push_back(',');
+            append_number(out, static_cast<int>(bends[i]));
+        }
+        out.push_back('\n');
+    }
+}
+
+void basic_pitch::write_notes_jsonl(const NoteEventTable &note_events,
+                                    int n_frames, std::vector<uint8_t> &out)
+{
+    std::vector<float> frame_times = model_frames_to_time(n_frames);
+
+    for (std::size_t n = 0; n < note_events.size(); ++n)
+    {
+        append(out, "{\"start_time\":");
+        append_number(out, frame_times[note_events.start_idx[n]]);
+        append(out, ",\"end_time\":");
+        append_number(out, frame_times[note_events.end_idx[n]]);
+        append(out, ",\"pitch\":");
+        append_number(out, note_events.pitch[n]);
+        append(out, ",\"velocity\":");
+        append_number(out, static_cast<int>(
+                               note_velocity(note_events.amplitude[n])));
+        append(out, ",\"amplitude\":");
+        append_number(out, note_events.amplitude[n]);
+
+        if (note_events.has_bends(n))
+        {
+            append(out, ",\"pitch_bends\":[");
+            const int8_t *bends = note_events.bends_of(n);
+            for (uint32_t i = 0; i < note_events.bend_length[n]; ++i)
+            {
+                if (i > 0)
+                {
+                    out.push_back(',');
+                }
+                append_number(out, static_cast<int>(bends[i]));
+            }
+            out.push_back(']');
+        }
+        append(out, "}\n");
+    }
+}
+
+void basic_pitch::convert_to_output(const InferenceResult &inference_result,
+                                    const BasicPitchConfig &config,
+                                    OutputFormat format,
+                                    std::vector<uint8_t> &out,
+                                    Workspace *workspace)
+{
+    if (format == OutputFormat::MIDI)
+    {
+        convert_to_midi(inference_result, config, out, nullptr, workspace);
+        return;
+    }
+
+    Workspace local_workspace;
+    Workspace &ws = workspace ? *workspace : local_workspace;
+
+    NoteEventTable &note_events =
+        extract_note_events(inference_result, config, ws);
+    if (!config.include_pitch_bends)
+    {
+        // extraction only sorts when it drops overlapping bends
+        note_events.sort();
+    }
+    int n_frames = inference_result.notes.dimension(0);
+
+    BP_TRACE_SCOPE("note format encode");
+    switch (format)
+    {
+    case OutputFormat::NOTES_BINARY:
+        write_notes_binary(note_events, n_frames, out);
+        break;
+    case OutputFormat::CSV:
+        write_notes_csv(note_events, n_frames, out);
+        break;
+    case OutputFormat::JSONL:
+    default:
+        write_notes_jsonl(note_events, n_frames, out);
+        break;
+    }
+}
+
+std::vector<uint8_t>
+basic_pitch::convert_to_output(const InferenceResult &inference_result,
+                               const BasicPitchConfig &config,
+                               OutputFormat format)
+{
+    std::vector<uint8_t> out;
+    convert_to_output(inference_result, config, format, out);
+    return out;
+}
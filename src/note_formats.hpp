@@ -0,0 +1,89 @@
+#ifndef BASIC_PITCH_NOTE_FORMATS_HPP
+#define BASIC_PITCH_NOTE_FORMATS_HPP
+
+#include "basicpitch.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace basic_pitch
+{
+enum class OutputFormat
+{
+    MIDI,
+    NOTES_BINARY,
+    CSV,
+    JSONL
+};
+
+// "midi", "bin", "csv" or "jsonl"; returns false for anything else
+bool parse_output_format(const std::string &name, OutputFormat &format);
+
+// file extension including the dot, e.g. ".mid"
+const char *output_format_extension(OutputFormat format);
+
+// Binary note file (.bpn), little-endian, meant to be memory-mapped:
+//
+//   NoteFileHeader                      16 bytes
+//   NoteRecord[note_count]              24 bytes each
+//   int8_t bends[bend_count]            all notes' pitch bends back to back
+//
+// Times are in seconds. A note's bends are one per model frame from its
+// start to its end, in contour bins (a third of a semitone) relative to
+// the note pitch.
+struct NoteFileHeader
+{
+    char magic[4]; // "BPNT"
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t note_count;
+    uint32_t bend_count;
+};
+
+struct NoteRecord
+{
+    float start_time;
+    float end_time;
+    float amplitude;
+    uint32_t bend_offset; // into the bends array
+    uint32_t bend_count;  // 0 if the note has no pitch bends
+    uint8_t pitch;        // MIDI note number
+    uint8_t velocity;     // as written to MIDI files
+    uint8_t reserved[2];  // zero
+};
+
+static_assert(sizeof(NoteFileHeader) == 16, "NoteFileHeader must be packed");
+static_assert(sizeof(NoteRecord) == 24, "NoteRecord must be packed");
+
+// version 1 had 20 byte records with a 16-bit bend_count
+constexpr uint16_t NOTE_FILE_VERSION = 2;
+
+// Serializers for an extracted note table; n_frames is the number of model
+// frames the note indices refer to. All of them append to out.
+void write_notes_binary(const NoteEventTable &note_events, int n_frames,
+                        std::vector<uint8_t> &out);
+
+// start_time_s,end_time_s,pitch_midi,velocity,pitch_bend with the bends as
+// trailing columns, like basic-pitch's note CSV
+void write_notes_csv(const NoteEventTable &note_events, int n_frames,
+                     std::vector<uint8_t> &out);
+
+// one JSON object per note and line
+void write_notes_jsonl(const NoteEventTable &note_events, int n_frames,
+                       std::vector<uint8_t> &out);
+
+// Sibling of convert_to_midi producing any of the output formats, so note
+// data does not have to be parsed back out of a MIDI file
+std::vector<uint8_t> convert_to_output(const InferenceResult &inference_result,
+                                       const BasicPitchConfig &config,
+                                       OutputFormat format);
+
+// Same, appending to a caller-owned buffer, with scratch memory from
+// workspace if given
+void convert_to_output(const InferenceResult &inference_result,
+                       const BasicPitchConfig &config, OutputFormat format,
+                       std::vector<uint8_t> &out,
+                       Workspace *workspace = nullptr);
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_NOTE_FORMATS_HPP
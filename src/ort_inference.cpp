@@ -2,53 +2,106 @@
 #include <onnxruntime_cxx_api.h>
 #include <unsupported/Eigen/CXX11/Tensor>
 
-// this is the nmp model baked into a header file
 #include "basicpitch.hpp"
-#include "model.ort.h"
+#include "engine.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include "workspace.hpp"
 
 using namespace basic_pitch::constants;
 
-static Eigen::Tensor2dXf
-unwrap_output(const Eigen::Tensor3dRowMajorXf &tensor_3d,
-              int audio_original_length, int n_overlapping_frames)
+// Constants for processing; overlap 30 frames
+static const int N_OVERLAPPING_FRAMES = 30;
+static const int OVERLAP_LEN = N_OVERLAPPING_FRAMES * FFT_HOP;
+static const int HOP_SIZE = AUDIO_N_SAMPLES - OVERLAP_LEN;
+// frames each chunk contributes once the overlap is cut from both ends
+static const int KEPT_FRAMES = static_cast<int>(ANNOT_N_FRAMES) - N_OVERLAPPING_FRAMES;
+
+// Cut chunks [first_chunk, first_chunk + n_chunks) of the audio into input,
+// as if the audio were padded with OVERLAP_LEN / 2 zeros at the start; the
+// padding and anything past the end of the audio are zeros. mono_audio holds
+// the samples starting at audio_offset.
+static void fill_chunks(const float *mono_audio, int length, int audio_offset,
+                        int first_chunk, int n_chunks, float *input)
 {
-    int batch_size = tensor_3d.dimension(0); // Number of batches (chunks)
-    int n_times_short =
-        tensor_3d.dimension(1);           // Number of time steps per chunk
-    int n_freqs = tensor_3d.dimension(2); // Frequency bins
-
-    int n_olap = n_overlapping_frames / 2;
-
-    // Remove overlapping frames from both start and end
-    Eigen::array<int, 3> offsets = {0, n_olap, 0};
-    Eigen::array<int, 3> extents = {batch_size, n_times_short - 2 * n_olap,
-                                    n_freqs};
-    Eigen::Tensor<float, 3, Eigen::RowMajor> output_sliced =
-        tensor_3d.slice(offsets, extents);
+    BP_TRACE_SCOPE("pad/chunk");
+    const int chunk_size = AUDIO_N_SAMPLES;
+    int pad = OVERLAP_LEN / 2;
 
-    // Flatten the 3D tensor into a 2D tensor
-    int total_time_steps = batch_size * (n_times_short - 2 * n_olap);
-    Eigen::Tensor<float, 2, Eigen::RowMajor> unwrapped_output =
-        output_sliced.reshape(Eigen::array<int, 2>{total_time_steps, n_freqs});
+    for (int i = 0; i < n_chunks; ++i)
+    {
+        float *chunk_ptr = input + static_cast<std::size_t>(i) * chunk_size;
+        // index in mono_audio of chunk_ptr[0]
+        int first = (first_chunk + i) * HOP_SIZE - pad - audio_offset;
+
+        int copy_begin = std::max(0, -first);
+        int copy_end = std::min(chunk_size, length - first);
+        copy_end = std::max(copy_end, copy_begin);
+
+        std::fill(chunk_ptr, chunk_ptr + copy_begin, 0.0f);
+        std::copy(mono_audio + first + copy_begin, mono_audio + first + copy_end,
+                  chunk_ptr + copy_begin);
+        std::fill(chunk_ptr + copy_end, chunk_ptr + chunk_size, 0.0f);
+    }
+}
 
-    // Calculate the expected output length
-    int n_output_frames_original = static_cast<int>(
-        std::floor(audio_original_length *
-                   (ANNOTATIONS_FPS / static_cast<float>(AUDIO_SAMPLE_RATE))));
-    n_output_frames_original =
-        std::min(n_output_frames_original,
-                 static_cast<int>(unwrapped_output.dimension(0)));
+// Stitch a (chunk, time, freq) row-major model output for the chunks
+// starting at first_chunk into the column-major (time, freq) result for the
+// chunk range: the overlapping frames are cut from both ends of every chunk
+// and the result is trimmed to the length of the audio. unwrapped is sized
+// on the first call and starts at the first frame of the range. Each kept
+// chunk is copied straight into place, with no intermediate tensors.
+void basic_pitch::kernels::unwrap_output(const Ort::Value &output,
+                                         int first_chunk,
+                                         const ChunkRange &range,
+                                         Eigen::Tensor2dXf &unwrapped)
+{
+    BP_TRACE_SCOPE("unwrap");
+    std::vector<int64_t> shape = output.GetTensorTypeAndShapeInfo().GetShape();
+    int batch_size = shape[0];    // Number of batches (chunks)
+    int n_times_short = shape[1]; // Number of time steps per chunk
+    int n_freqs = shape[2];       // Frequency bins
+    const float *data = output.GetTensorData<float>();
+
+    int n_olap = N_OVERLAPPING_FRAMES / 2;
+    int n_kept = n_times_short - 2 * n_olap;
+    int first_frame = range.first_chunk * n_kept;
+
+    if (unwrapped.size() == 0)
+    {
+        // Calculate the expected output length
+        int n_output_frames_original = static_cast<int>(std::floor(
+            range.total_length *
+            (ANNOTATIONS_FPS / static_cast<float>(AUDIO_SAMPLE_RATE))));
+        n_output_frames_original =
+            std::min(n_output_frames_original, range.n_chunks_total * n_kept);
+        int end_frame =
+            std::min(n_output_frames_original, range.end_chunk * n_kept);
+        unwrapped.resize(std::max(0, end_frame - first_frame), n_freqs);
+    }
 
-    // Trim the output tensor to match the original audio length
-    Eigen::Tensor<float, 2, Eigen::RowMajor> final_output =
-        unwrapped_output.slice(
-            Eigen::array<int, 2>{0, 0},
-            Eigen::array<int, 2>{n_output_frames_original, n_freqs});
+    typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
+                          Eigen::RowMajor>
+        RowMajorMatrixXf;
 
-    // Return the final output as a column-major tensor
-    return final_output.swap_layout().shuffle(Eigen::array<int, 2>{1, 0});
+    int n_frames = unwrapped.dimension(0);
+    Eigen::Map<Eigen::MatrixXf> out(unwrapped.data(), n_frames, n_freqs);
+    for (int i = 0; i < batch_size; ++i)
+    {
+        int first = (first_chunk + i) * n_kept - first_frame;
+        int rows = std::min(n_kept, n_frames - first);
+        if (rows <= 0)
+        {
+            break;
+        }
+        out.middleRows(first, rows) = Eigen::Map<const RowMajorMatrixXf>(
+            data + (static_cast<std::size_t>(i) * n_times_short + n_olap) *
+                       n_freqs,
+            rows, n_freqs);
+    }
 }
 
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
 basic_pitch::InferenceResult
 basic_pitch::ort_inference(const std::vector<float> &mono_audio)
 {
@@ -58,167 +111,91 @@ basic_pitch::ort_inference(const std::vector<float> &mono_audio)
 basic_pitch::InferenceResult basic_pitch::ort_inference(const float *mono_audio,
                                                         int length)
 {
-    // Initialize ONNX Runtime environment with ERROR level to suppress schema warnings
-    Ort::Env env(ORT_LOGGING_LEVEL_ERROR, "basic_pitch");
-
-    // Set session options (use defaults)
-    Ort::SessionOptions session_options;
-
-    // Create the ONNX Runtime session from the in-memory ORT model
-    Ort::Session session(env, model_ort_start, model_ort_size, session_options);
-
-    // Constants for processing; overlap 30 frames
-    const int chunk_size = AUDIO_N_SAMPLES;
-    int n_overlapping_frames = 30;
-    int overlap_len = n_overlapping_frames * FFT_HOP;
-    int hop_size = AUDIO_N_SAMPLES - overlap_len;
-
-    // Padding the start of the audio (overlap_len / 2 zeros at the start)
-    std::vector<float> padded_audio(overlap_len / 2, 0.0f);
-    padded_audio.insert(padded_audio.end(), mono_audio, mono_audio + length);
-
-    // Calculate the new length after padding
-    int padded_length = padded_audio.size();
-    int num_chunks = (padded_length + hop_size - 1) / hop_size;
-
-    Ort::AllocatorWithDefaultOptions allocator;
-    std::array<int64_t, 3> input_shape = {num_chunks, chunk_size, 1};
-
-    // Allocate ONNX tensor up front
-    Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-        allocator, input_shape.data(), input_shape.size());
-
-    float *ort_tensor_data = input_tensor.GetTensorMutableData<float>();
-
-    for (int chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx)
-    {
-        int start_pos = chunk_idx * hop_size;
-        int actual_chunk_size = std::min(chunk_size, padded_length - start_pos);
-
-        std::copy(padded_audio.begin() + start_pos,
-                  padded_audio.begin() + start_pos + actual_chunk_size,
-                  ort_tensor_data + chunk_idx * chunk_size); // ORT tensor
-
-        // Zero-pad the last chunk if it's smaller than chunk_size
-        if (actual_chunk_size < chunk_size)
-        {
-            std::fill(ort_tensor_data + chunk_idx * chunk_size +
-                          actual_chunk_size,
-                      ort_tensor_data + (chunk_idx + 1) * chunk_size, 0.0f);
-        }
-    }
-
-    // Input and output names
-    const char *input_names[] = {"serving_default_input_2:0"};
-    const char *output_names[] = {
-        "StatefulPartitionedCall:1", // note
-        "StatefulPartitionedCall:2", // onset
-        "StatefulPartitionedCall:0"  // contour
-    };
-
-    // Run the inference
-    auto output_tensors = session.Run(Ort::RunOptions{nullptr}, input_names,
-                                      &input_tensor, 1, output_names, 3);
-
-    // Retrieve and process shapes for each output
-    std::vector<int64_t> note_shape =
-        output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
-    std::vector<int64_t> onset_shape =
-        output_tensors[1].GetTensorTypeAndShapeInfo().GetShape();
-    std::vector<int64_t> contour_shape =
-        output_tensors[2].GetTensorTypeAndShapeInfo().GetShape();
-
-    int batch_size = note_shape[0];
-    int n_times_short_notes =
-        note_shape[1]; // Number of time steps for notes and onsets
-    int n_freqs_notes = note_shape[2]; // 88 for notes and onsets
-    int n_times_short_contours = contour_shape[1];
-    int n_freqs_contours = contour_shape[2]; // 264 for contours
-
-    // Get the original length of the audio (in samples)
-    int audio_original_length = length;
-
-    // Access raw output data
-    float *note_data = output_tensors[0].GetTensorMutableData<float>();
-    float *onset_data = output_tensors[1].GetTensorMutableData<float>();
-    float *contour_data = output_tensors[2].GetTensorMutableData<float>();
-
-    // Use Eigen::TensorMap to map the ONNX Runtime row-major data
-    Eigen::TensorMap<Eigen::Tensor3dRowMajorXf> note_tensor(
-        note_data, batch_size, n_times_short_notes, n_freqs_notes);
-    Eigen::TensorMap<Eigen::Tensor3dRowMajorXf> onset_tensor(
-        onset_data, batch_size, n_times_short_notes, n_freqs_notes);
-    Eigen::TensorMap<Eigen::Tensor3dRowMajorXf> contour_tensor(
-        contour_data, batch_size, n_times_short_contours, n_freqs_contours);
-
-    // Use unwrap_output to unwrap and convert the row-major 3D tensors to
-    // col-major 2D tensors
-    Eigen::Tensor2dXf unwrapped_notes =
-        unwrap_output(note_tensor, audio_original_length, 30);
-    Eigen::Tensor2dXf unwrapped_onsets =
-        unwrap_output(onset_tensor, audio_original_length, 30);
-    Eigen::Tensor2dXf unwrapped_contours =
-        unwrap_output(contour_tensor, audio_original_length, 30);
-
-    return InferenceResult{unwrapped_notes, unwrapped_onsets,
-                           unwrapped_contours};
+    // a one-off session on the embedded model
+    Engine engine;
+    return engine.infer(mono_audio, length);
 }
+#endif
 
 basic_pitch::InferenceResult
-basic_pitch::ort_inference_with_session(Ort::Session &session, const std::vector<float> &mono_audio)
+basic_pitch::ort_inference_with_session(Ort::Session &session, const std::vector<float> &mono_audio, Workspace *workspace)
 {
-    return ort_inference_with_session(session, mono_audio.data(), mono_audio.size());
+    return ort_inference_with_session(session, mono_audio.data(), mono_audio.size(), workspace);
 }
 
-basic_pitch::InferenceResult basic_pitch::ort_inference_with_session(Ort::Session &session, const float *mono_audio, int length)
+basic_pitch::InferenceResult basic_pitch::ort_inference_with_session(Ort::Session &session, const float *mono_audio, int length, Workspace *workspace)
 {
-    // Constants for processing; overlap 30 frames
-    const int chunk_size = AUDIO_N_SAMPLES;
-    int n_overlapping_frames = 30;
-    int overlap_len = n_overlapping_frames * FFT_HOP;
-    int hop_size = AUDIO_N_SAMPLES - overlap_len;
+    // all chunks in a single session.Run
+    return ort_inference_in_batches(session, mono_audio, length, 0, nullptr,
+                                    workspace);
+}
 
-    // Padding the start of the audio (overlap_len / 2 zeros at the start)
-    std::vector<float> padded_audio(overlap_len / 2, 0.0f);
-    padded_audio.insert(padded_audio.end(), mono_audio, mono_audio + length);
+int basic_pitch::ort_num_chunks(int length)
+{
+    int padded_length = OVERLAP_LEN / 2 + length;
+    return (padded_length + HOP_SIZE - 1) / HOP_SIZE;
+}
 
-    // Calculate the new length after padding
-    int padded_length = padded_audio.size();
-    int num_chunks = (padded_length + hop_size - 1) / hop_size;
+int basic_pitch::ort_chunk_first_frame(int chunk)
+{
+    return chunk * KEPT_FRAMES;
+}
 
-    Ort::AllocatorWithDefaultOptions allocator;
-    std::array<int64_t, 3> input_shape = {num_chunks, chunk_size, 1};
+void basic_pitch::ort_chunk_samples(int total_length, int first_chunk,
+                                    int n_chunks, int &begin, int &end)
+{
+    int pad = OVERLAP_LEN / 2;
+    begin = std::clamp(first_chunk * HOP_SIZE - pad, 0, total_length);
+    end = std::clamp((first_chunk + n_chunks - 1) * HOP_SIZE - pad +
+                         static_cast<int>(AUDIO_N_SAMPLES),
+                     begin, total_length);
+}
 
-    // Allocate ONNX tensor up front
-    Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-        allocator, input_shape.data(), input_shape.size());
+basic_pitch::InferenceResult basic_pitch::ort_inference_in_batches(
+    Ort::Session &session, const float *mono_audio, int length,
+    int batch_chunks, const InferenceProgress &progress, Workspace *workspace)
+{
+    return ort_inference_chunk_range(session, mono_audio, length, 0, length,
+                                     0, ort_num_chunks(length), batch_chunks,
+                                     progress, workspace);
+}
 
-    float *input_tensor_data = input_tensor.GetTensorMutableData<float>();
+basic_pitch::InferenceResult basic_pitch::ort_inference_chunk_range(
+    Ort::Session &session, const float *audio, int length, int audio_offset,
+    int total_length, int first_chunk, int n_chunks, int batch_chunks,
+    const InferenceProgress &progress, Workspace *workspace)
+{
+    BP_TRACE_SCOPE("inference");
+    const int chunk_size = AUDIO_N_SAMPLES;
 
-    // Fill the tensor with audio chunks
-    for (int chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx)
+    kernels::ChunkRange range;
+    range.n_chunks_total = ort_num_chunks(total_length);
+    range.first_chunk = std::clamp(first_chunk, 0, range.n_chunks_total);
+    range.end_chunk =
+        std::clamp(first_chunk + n_chunks, range.first_chunk,
+                   range.n_chunks_total);
+    range.total_length = total_length;
+    n_chunks = range.end_chunk - range.first_chunk;
+
+    InferenceResult result;
+    if (n_chunks == 0)
     {
-        int start_sample = chunk_idx * hop_size;
-        int end_sample = std::min(start_sample + chunk_size, padded_length);
-        int actual_chunk_size = end_sample - start_sample;
-
-        // Get pointer to the chunk in the tensor
-        float *chunk_ptr = input_tensor_data + chunk_idx * chunk_size;
-
-        // Copy audio data into this chunk
-        for (int i = 0; i < actual_chunk_size; ++i)
-        {
-            chunk_ptr[i] = padded_audio[start_sample + i];
-        }
-
-        // Zero-pad if necessary
-        for (int i = actual_chunk_size; i < chunk_size; ++i)
-        {
-            chunk_ptr[i] = 0.0f;
-        }
+        return result;
+    }
+    if (batch_chunks <= 0 || batch_chunks > n_chunks)
+    {
+        batch_chunks = n_chunks;
     }
 
-    // Run inference
+    // The input tensor wraps the workspace's buffer (or a local one), so ORT
+    // does not allocate it; it holds one batch of chunks
+    Workspace local_workspace;
+    Workspace &ws = workspace ? *workspace : local_workspace;
+    float *input_data = ws.use(
+        ws.model_input, static_cast<std::size_t>(batch_chunks) * chunk_size);
+    Ort::MemoryInfo memory_info =
+        Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
     const char *input_names[] = {"serving_default_input_2:0"};
     const char *output_names[] = {
         "StatefulPartitionedCall:1", // note
@@ -226,45 +203,36 @@ basic_pitch::InferenceResult basic_pitch::ort_inference_with_session(Ort::Sessio
         "StatefulPartitionedCall:0"  // contour
     };
 
-    auto output_tensors = session.Run(Ort::RunOptions{nullptr}, input_names,
-                                     &input_tensor, 1, output_names, 3);
-
-    // Extract output data
-    const auto *notes_data = output_tensors[0].GetTensorData<float>();
-    const auto *onsets_data = output_tensors[1].GetTensorData<float>();
-    const auto *contours_data = output_tensors[2].GetTensorData<float>();
-
-    // Get output tensor shapes
-    auto notes_shape = output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
-    auto onsets_shape = output_tensors[1].GetTensorTypeAndShapeInfo().GetShape();
-    auto contours_shape = output_tensors[2].GetTensorTypeAndShapeInfo().GetShape();
+    for (int batch_first = range.first_chunk; batch_first < range.end_chunk;
+         batch_first += batch_chunks)
+    {
+        int batch_size = std::min(batch_chunks, range.end_chunk - batch_first);
+        fill_chunks(audio, length, audio_offset, batch_first, batch_size,
+                    input_data);
 
-    // Create 3D tensors from the output data
-    Eigen::Tensor3dRowMajorXf notes_tensor_3d(
-        static_cast<long>(notes_shape[0]),
-        static_cast<long>(notes_shape[1]),
-        static_cast<long>(notes_shape[2])
-    );
-    Eigen::Tensor3dRowMajorXf onsets_tensor_3d(
-        static_cast<long>(onsets_shape[0]),
-        static_cast<long>(onsets_shape[1]),
-        static_cast<long>(onsets_shape[2])
-    );
-    Eigen::Tensor3dRowMajorXf contours_tensor_3d(
-        static_cast<long>(contours_shape[0]),
-        static_cast<long>(contours_shape[1]),
-        static_cast<long>(contours_shape[2])
-    );
+        std::array<int64_t, 3> input_shape = {batch_size, chunk_size, 1};
+        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
+            memory_info, input_data,
+            static_cast<std::size_t>(batch_size) * chunk_size,
+            input_shape.data(), input_shape.size());
 
-    // Copy data from ONNX tensors to Eigen tensors
-    std::memcpy(notes_tensor_3d.data(), notes_data, notes_tensor_3d.size() * sizeof(float));
-    std::memcpy(onsets_tensor_3d.data(), onsets_data, onsets_tensor_3d.size() * sizeof(float));
-    std::memcpy(contours_tensor_3d.data(), contours_data, contours_tensor_3d.size() * sizeof(float));
+        std::vector<Ort::Value> output_tensors;
+        {
+            BP_TRACE_SCOPE("session.Run");
+            output_tensors =
+                session.Run(Ort::RunOptions{nullptr}, input_names,
+                            &input_tensor, 1, output_names, 3);
+        }
 
-    // Unwrap the outputs
-    auto unwrapped_notes = unwrap_output(notes_tensor_3d, length, n_overlapping_frames);
-    auto unwrapped_onsets = unwrap_output(onsets_tensor_3d, length, n_overlapping_frames);
-    auto unwrapped_contours = unwrap_output(contours_tensor_3d, length, n_overlapping_frames);
+        // Only the stitched posteriorgrams outlive the batch
+        kernels::unwrap_output(output_tensors[0], batch_first, range, result.notes);
+        kernels::unwrap_output(output_tensors[1], batch_first, range, result.onsets);
+        kernels::unwrap_output(output_tensors[2], batch_first, range, result.contours);
 
-    return {unwrapped_notes, unwrapped_onsets, unwrapped_contours};
+        if (progress)
+        {
+            progress(batch_first + batch_size - range.first_chunk, n_chunks);
+        }
+    }
+    return result;
 }
@@ -0,0 +1,85 @@
+#ifndef BASIC_PITCH_PARALLEL_HPP
+#define BASIC_PITCH_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define BASIC_PITCH_HAS_THREADS 1
+#include <thread>
+#endif
+
+namespace basic_pitch
+{
+#ifdef BASIC_PITCH_HAS_THREADS
+namespace detail
+{
+// set on parallel_for workers so nested calls stay on their thread
+inline thread_local bool in_parallel_for = false;
+} // namespace detail
+#endif
+
+// Run fn(i) for every i in [0, n), split into contiguous slices across at
+// most max_threads threads (0: the hardware threads). Stays on the calling
+// thread for small n and in builds without thread support (the default
+// single-threaded WASM build), and when nested inside another parallel_for.
+template <typename Fn>
+void parallel_for(std::size_t n, Fn &&fn,
+                  [[maybe_unused]] std::size_t min_per_thread = 64,
+                  [[maybe_unused]] std::size_t max_threads = 0)
+{
+    std::size_t n_threads = 1;
+#ifdef BASIC_PITCH_HAS_THREADS
+    std::size_t hardware_threads =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    if (max_threads == 0 || max_threads > hardware_threads)
+    {
+        max_threads = hardware_threads;
+    }
+    n_threads = std::min(max_threads,
+                         (n + min_per_thread - 1) / min_per_thread);
+    if (detail::in_parallel_for)
+    {
+        n_threads = 1;
+    }
+#endif
+
+    if (n_threads <= 1)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+#ifdef BASIC_PITCH_HAS_THREADS
+    std::size_t slice = (n + n_threads - 1) / n_threads;
+    auto run_slice = [&](std::size_t t)
+    {
+        bool was_nested = detail::in_parallel_for;
+        detail::in_parallel_for = true;
+        std::size_t end = std::min(n, (t + 1) * slice);
+        for (std::size_t i = t * slice; i < end; ++i)
+        {
+            fn(i);
+        }
+        detail::in_parallel_for = was_nested;
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < n_threads; ++t)
+    {
+        workers.emplace_back(run_slice, t);
+    }
+    run_slice(0);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+#endif
+}
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_PARALLEL_HPP
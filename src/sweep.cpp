@@ -0,0 +1,60 @@
+#include "sweep.hpp"
+#include "parallel.hpp"
+#include <sstream>
+
+std::vector<basic_pitch::BasicPitchConfig>
+basic_pitch::expand_sweep_grid(const BasicPitchConfig &base,
+                               const SweepGrid &grid)
+{
+    std::vector<float> onsets = grid.onset_thresholds;
+    std::vector<float> frames = grid.frame_thresholds;
+    std::vector<int> lengths = grid.min_note_lengths;
+    if (onsets.empty())
+        onsets.push_back(base.onset_threshold);
+    if (frames.empty())
+        frames.push_back(base.frame_threshold);
+    if (lengths.empty())
+        lengths.push_back(base.min_note_length);
+
+    std::vector<BasicPitchConfig> configs;
+    configs.reserve(onsets.size() * frames.size() * lengths.size());
+    for (float onset : onsets)
+    {
+        for (float frame : frames)
+        {
+            for (int length : lengths)
+            {
+                BasicPitchConfig config = base;
+                config.onset_threshold = onset;
+                config.frame_threshold = frame;
+                config.min_note_length = length;
+                configs.push_back(config);
+            }
+        }
+    }
+    return configs;
+}
+
+std::string basic_pitch::sweep_label(const BasicPitchConfig &config)
+{
+    std::ostringstream label;
+    label << "onset" << config.onset_threshold << "_frame"
+          << config.frame_threshold << "_len" << config.min_note_length;
+    return label.str();
+}
+
+std::vector<std::vector<uint8_t>>
+basic_pitch::convert_sweep(const InferenceResult &inference_result,
+                           const std::vector<BasicPitchConfig> &configs,
+                           OutputFormat format)
+{
+    // configs only read the shared inference result, so each one is an
+    // independent task
+    std::vector<std::vector<uint8_t>> outputs(configs.size());
+    parallel_for(
+        configs.size(),
+        [&](std::size_t i)
+        { outputs[i] = convert_to_output(inference_result, configs[i], format); },
+        1);
+    return outputs;
+}
@@ -0,0 +1,37 @@
+#ifndef BASIC_PITCH_SWEEP_HPP
+#define BASIC_PITCH_SWEEP_HPP
+
+#include "basicpitch.hpp"
+#include "note_formats.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace basic_pitch
+{
+// Values to sweep; an empty list keeps the base config's value
+struct SweepGrid
+{
+    std::vector<float> onset_thresholds;
+    std::vector<float> frame_thresholds;
+    std::vector<int> min_note_lengths;
+};
+
+// Cartesian product of the grid applied on top of base, onset threshold
+// varying slowest
+std::vector<BasicPitchConfig> expand_sweep_grid(const BasicPitchConfig &base,
+                                                const SweepGrid &grid);
+
+// Short file-name-safe tag such as "onset0.5_frame0.3_len11"
+std::string sweep_label(const BasicPitchConfig &config);
+
+// Post-process one inference result under every config, in parallel; the
+// model runs once no matter how many configs there are. Outputs are in the
+// order of configs.
+std::vector<std::vector<uint8_t>>
+convert_sweep(const InferenceResult &inference_result,
+              const std::vector<BasicPitchConfig> &configs,
+              OutputFormat format = OutputFormat::MIDI);
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_SWEEP_HPP
@@ -0,0 +1,185 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct TraceEvent
+{
+    const char *name;
+    int thread;
+    int64_t start_us;
+    int64_t duration_us;
+};
+
+std::atomic<bool> g_enabled{false};
+std::mutex g_events_mutex;
+std::vector<TraceEvent> g_events;
+
+// open_stream() target and how many events it holds; guarded by
+// g_events_mutex like the events
+std::ofstream g_stream;
+std::size_t g_streamed_events = 0;
+constexpr std::size_t MAX_BUFFERED_EVENTS = 65536;
+
+// timestamps are relative to the first use, to keep them short
+const Clock::time_point g_epoch = Clock::now();
+
+// small, stable per-thread ids for the viewer's rows
+int thread_index()
+{
+    static std::atomic<int> next_index{0};
+    thread_local int index = next_index++;
+    return index;
+}
+
+int64_t microseconds_since_epoch(Clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - g_epoch)
+        .count();
+}
+
+void write_event(std::ostream &out, const TraceEvent &event)
+{
+    // span names are literals without characters needing escapes
+    out << "{\"name\":\"" << event.name
+        << "\",\"cat\":\"basic_pitch\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+        << event.thread << ",\"ts\":" << event.start_us
+        << ",\"dur\":" << event.duration_us << "}";
+}
+
+// Appends g_events to the stream and empties it; g_events_mutex held
+bool flush_locked()
+{
+    if (!g_stream.is_open())
+    {
+        return true;
+    }
+    for (const TraceEvent &event : g_events)
+    {
+        g_stream << (g_streamed_events++ > 0 ? ",\n" : "\n");
+        write_event(g_stream, event);
+    }
+    g_events.clear();
+    g_stream.flush();
+    return static_cast<bool>(g_stream);
+}
+} // namespace
+
+void basic_pitch::trace::enable(bool on)
+{
+    g_enabled.store(on, std::memory_order_relaxed);
+}
+
+bool basic_pitch::trace::enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void basic_pitch::trace::clear()
+{
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    g_events.clear();
+}
+
+void basic_pitch::trace::write_json(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    out << "{\"traceEvents\":[";
+    for (std::size_t i = 0; i < g_events.size(); ++i)
+    {
+        out << (i > 0 ? ",\n" : "\n");
+        write_event(out, g_events[i]);
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool basic_pitch::trace::write_json_file(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+    write_json(out);
+    return static_cast<bool>(out);
+}
+
+bool basic_pitch::trace::open_stream(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    g_stream.open(path);
+    g_streamed_events = 0;
+    g_stream << "[";
+    return static_cast<bool>(g_stream);
+}
+
+bool basic_pitch::trace::flush_stream()
+{
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    return flush_locked();
+}
+
+void basic_pitch::trace::close_stream()
+{
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    if (g_stream.is_open())
+    {
+        flush_locked();
+        g_stream << "\n]\n";
+        g_stream.close();
+    }
+}
+
+std::vector<basic_pitch::trace::SpanTotal> basic_pitch::trace::span_totals()
+{
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    std::vector<SpanTotal> totals;
+    for (const TraceEvent &event : g_events)
+    {
+        auto total = std::find_if(totals.begin(), totals.end(),
+                                  [&event](const SpanTotal &t)
+                                  { return t.name == event.name; });
+        if (total == totals.end())
+        {
+            totals.push_back({event.name, 0, 0});
+            total = totals.end() - 1;
+        }
+        total->count++;
+        total->total_us += event.duration_us;
+    }
+    return totals;
+}
+
+basic_pitch::trace::Span::Span(const char *name)
+    : name_(name), active_(enabled())
+{
+    if (active_)
+    {
+        start_ = Clock::now();
+    }
+}
+
+basic_pitch::trace::Span::~Span()
+{
+    if (!active_)
+    {
+        return;
+    }
+    Clock::time_point end = Clock::now();
+    TraceEvent event{name_, thread_index(), microseconds_since_epoch(start_),
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         end - start_)
+                         .count()};
+    std::lock_guard<std::mutex> lock(g_events_mutex);
+    g_events.push_back(event);
+    if (g_events.size() >= MAX_BUFFERED_EVENTS)
+    {
+        flush_locked();
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef BASIC_PITCH_TRACE_HPP
+#define BASIC_PITCH_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Stage-level tracing: BP_TRACE_SCOPE("name") records how long the rest of
+// the enclosing scope takes, on the calling thread, as a Chrome trace event
+// (load the written JSON in chrome://tracing or ui.perfetto.dev).
+//
+// Recording is off until trace::enable(); a span then only costs an atomic
+// load. Builds without BASIC_PITCH_TRACING compile the spans out entirely.
+#ifdef BASIC_PITCH_TRACING
+#define BP_TRACE_CONCAT_INNER(a, b) a##b
+#define BP_TRACE_CONCAT(a, b) BP_TRACE_CONCAT_INNER(a, b)
+#define BP_TRACE_SCOPE(name)                                                   \
+    basic_pitch::trace::Span BP_TRACE_CONCAT(bp_trace_span_, __LINE__)(name)
+#else
+#define BP_TRACE_SCOPE(name) ((void)0)
+#endif
+
+namespace basic_pitch
+{
+namespace trace
+{
+// Whether spans are compiled in (BASIC_PITCH_TRACING)
+constexpr bool compiled_in()
+{
+#ifdef BASIC_PITCH_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Start or stop recording; events recorded so far are kept
+void enable(bool on = true);
+bool enabled();
+
+// Drop all recorded events
+void clear();
+
+// Write the recorded events in the Chrome trace-event JSON format; the file
+// variant returns false if it cannot be written
+void write_json(std::ostream &out);
+bool write_json_file(const std::string &path);
+
+// Stream events to path instead of keeping them for write_json, for
+// long-running processes: flush_stream() appends the events recorded since
+// the last flush and drops them, and recording flushes on its own once
+// 65536 events are buffered. The file is a JSON array of trace events,
+// which chrome://tracing and Perfetto load even without the closing bracket
+// close_stream() adds, so it stays usable if the process is killed.
+// open_stream returns false if the file cannot be created, flush_stream if
+// it cannot be written; both are no-ops without an open stream.
+bool open_stream(const std::string &path);
+bool flush_stream();
+void close_stream();
+
+// Number and total duration of the recorded spans of each name, in the order
+// the names first completed; spans nest, so totals overlap
+struct SpanTotal
+{
+    std::string name;
+    int count = 0;
+    int64_t total_us = 0;
+};
+std::vector<SpanTotal> span_totals();
+
+// Records [construction, destruction) as a complete ("X") event named name,
+// which must outlive the trace (a string literal)
+class Span
+{
+  public:
+    explicit Span(const char *name);
+    ~Span();
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+  private:
+    const char *name_;
+    std::chrono::steady_clock::time_point start_;
+    bool active_;
+};
+} // namespace trace
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_TRACE_HPP
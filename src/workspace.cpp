@@ -0,0 +1,127 @@
+#include "workspace.hpp"
+#include <algorithm>
+
+namespace
+{
+template <typename T> std::size_t capacity_bytes(const std::vector<T> &buffer)
+{
+    return buffer.capacity() * sizeof(T);
+}
+
+template <typename T> std::size_t size_bytes(const std::vector<T> &buffer)
+{
+    return buffer.size() * sizeof(T);
+}
+
+std::size_t table_capacity(const basic_pitch::NoteEventTable &table)
+{
+    return capacity_bytes(table.start_idx) + capacity_bytes(table.end_idx) +
+           capacity_bytes(table.pitch) + capacity_bytes(table.amplitude) +
+           capacity_bytes(table.bend_offset) +
+           capacity_bytes(table.bend_length) + capacity_bytes(table.bends);
+}
+
+std::size_t table_size(const basic_pitch::NoteEventTable &table)
+{
+    return size_bytes(table.start_idx) + size_bytes(table.end_idx) +
+           size_bytes(table.pitch) + size_bytes(table.amplitude) +
+           size_bytes(table.bend_offset) + size_bytes(table.bend_length) +
+           size_bytes(table.bends);
+}
+
+template <typename T> void free_buffer(std::vector<T> &buffer)
+{
+    std::vector<T>().swap(buffer);
+}
+} // namespace
+
+std::size_t basic_pitch::Workspace::begin_append(NoteEventTable &table)
+{
+    table.clear();
+    return table_capacity(table);
+}
+
+void basic_pitch::Workspace::used(const NoteEventTable &table,
+                                  std::size_t capacity_before)
+{
+    account(table_size(table), table_capacity(table) > capacity_before);
+}
+
+void basic_pitch::Workspace::account(std::size_t bytes, bool fresh)
+{
+    job_bytes_ += bytes;
+    if (fresh)
+    {
+        fresh_bytes_ += bytes;
+    }
+    else
+    {
+        reused_bytes_ += bytes;
+    }
+}
+
+std::size_t basic_pitch::Workspace::held_bytes() const
+{
+    return capacity_bytes(model_input) + capacity_bytes(energy) +
+           capacity_bytes(peaks) + table_capacity(notes) +
+           capacity_bytes(midi_events) + capacity_bytes(output);
+}
+
+void basic_pitch::Workspace::end_job()
+{
+    jobs_++;
+    window_peak_ = std::max(window_peak_, job_bytes_);
+    job_bytes_ = 0;
+    if (++window_jobs_ == WINDOW_JOBS)
+    {
+        previous_window_peak_ = window_peak_;
+        window_peak_ = 0;
+        window_jobs_ = 0;
+    }
+
+    // buffers regrow to the current size on the next job
+    std::size_t recent_peak = std::max(window_peak_, previous_window_peak_);
+    if (held_bytes() > 2 * recent_peak)
+    {
+        release();
+        releases_++;
+    }
+    capacity_bytes_ = held_bytes();
+}
+
+void basic_pitch::Workspace::release()
+{
+    free_buffer(model_input);
+    free_buffer(energy);
+    free_buffer(peaks);
+    notes = NoteEventTable{};
+    free_buffer(midi_events);
+    free_buffer(output);
+    capacity_bytes_ = 0;
+}
+
+basic_pitch::Workspace::Stats basic_pitch::Workspace::stats() const
+{
+    Stats stats;
+    stats.jobs = jobs_;
+    stats.reused_bytes = reused_bytes_;
+    stats.fresh_bytes = fresh_bytes_;
+    stats.capacity_bytes = capacity_bytes_;
+    stats.releases = releases_;
+    return stats;
+}
+
+void basic_pitch::Workspace::print_stats(std::ostream &out,
+                                         const char *name) const
+{
+    Stats s = stats();
+    std::size_t total = s.reused_bytes + s.fresh_bytes;
+    double reused_percent =
+        total > 0 ? 100.0 * static_cast<double>(s.reused_bytes) / total : 0.0;
+
+    out << "Workspace " << name << ": " << s.jobs << " jobs, "
+        << s.reused_bytes / 1024 << " KiB reused, " << s.fresh_bytes / 1024
+        << " KiB fresh (" << static_cast<int>(reused_percent)
+        << "% reused), " << s.capacity_bytes / 1024 << " KiB held, "
+        << s.releases << " releases" << std::endl;
+}
@@ -0,0 +1,103 @@
+#ifndef BASIC_PITCH_WORKSPACE_HPP
+#define BASIC_PITCH_WORKSPACE_HPP
+
+#include "basicpitch.hpp"
+#include "midi_writer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace basic_pitch
+{
+// Scratch buffers for one transcription worker, reused from job to job so a
+// long-running process does not allocate and free the same large buffers on
+// every request. Buffers keep their capacity between jobs; once that is far
+// more than recent jobs needed (say after one unusually long file), it is
+// given back and regrown to the current size.
+//
+// Not thread-safe: use one workspace per worker thread. stats() may be
+// called from any thread.
+class Workspace
+{
+  public:
+    struct Stats
+    {
+        std::size_t jobs = 0;
+        std::size_t reused_bytes = 0;   // served from existing capacity
+        std::size_t fresh_bytes = 0;    // needed a new allocation
+        std::size_t capacity_bytes = 0; // held between jobs
+        std::size_t releases = 0;       // times capacity was given back
+    };
+
+    // Size buffer to n elements for the current job; the contents are
+    // unspecified
+    template <typename T> T *use(std::vector<T> &buffer, std::size_t n)
+    {
+        account(n * sizeof(T), n > buffer.capacity());
+        buffer.resize(n);
+        return buffer.data();
+    }
+
+    // For buffers filled by appending: begin_append() empties the buffer and
+    // returns its capacity, to be passed to used() once it is filled
+    template <typename T> std::size_t begin_append(std::vector<T> &buffer)
+    {
+        buffer.clear();
+        return buffer.capacity();
+    }
+
+    template <typename T>
+    void used(const std::vector<T> &buffer, std::size_t capacity_before)
+    {
+        account(buffer.size() * sizeof(T), buffer.capacity() > capacity_before);
+    }
+
+    std::size_t begin_append(NoteEventTable &table);
+    void used(const NoteEventTable &table, std::size_t capacity_before);
+
+    // Marks the end of a job and gives back capacity if it is more than
+    // twice what the largest recent job needed
+    void end_job();
+
+    // Frees every buffer
+    void release();
+
+    Stats stats() const;
+    void print_stats(std::ostream &out, const char *name) const;
+
+    // model input: the audio cut into overlapping windows
+    std::vector<float> model_input;
+    // note creation: remaining energy, onset peaks and the note table
+    std::vector<float> energy;
+    std::vector<std::pair<int, int>> peaks;
+    NoteEventTable notes;
+    // MIDI encoding: events before delta-time encoding
+    std::vector<TimedMidiEvent> midi_events;
+    // encoded output file
+    std::vector<uint8_t> output;
+
+  private:
+    void account(std::size_t bytes, bool fresh);
+    std::size_t held_bytes() const;
+
+    // the largest job of the current and the previous window of this many
+    // jobs sets the size that is kept
+    static constexpr int WINDOW_JOBS = 16;
+
+    std::size_t job_bytes_ = 0;
+    std::size_t window_peak_ = 0;
+    std::size_t previous_window_peak_ = 0;
+    int window_jobs_ = 0;
+
+    std::atomic<std::size_t> jobs_{0};
+    std::atomic<std::size_t> reused_bytes_{0};
+    std::atomic<std::size_t> fresh_bytes_{0};
+    std::atomic<std::size_t> capacity_bytes_{0};
+    std::atomic<std::size_t> releases_{0};
+};
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_WORKSPACE_HPP
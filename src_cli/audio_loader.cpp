@@ -0,0 +1,329 @@
+#include "audio_loader.hpp"
+#include "basicpitch.hpp"
+#include "resampler_cache.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <libnyquist/Common.h>
+#include <libnyquist/Decoders.h>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace basic_pitch::constants;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+} // namespace
+
+std::vector<float>
+basic_pitch::resample_to_model_rate(const std::vector<float> &mono_audio,
+                                    int sample_rate)
+{
+    BP_TRACE_SCOPE("resample");
+    // Resampling using Oboe's resampler module; instances and their
+    // coefficient tables are reused across files for the same rate pair
+    ResamplerCache::Lease resampler = ResamplerCache::instance().acquire(
+        1, // Mono (1 channel)
+        sample_rate, SAMPLE_RATE, ResamplerCache::Quality::Best);
+
+    int numInputFrames = mono_audio.size();
+    int numOutputFrames = static_cast<int>(
+        static_cast<double>(numInputFrames) * SAMPLE_RATE / sample_rate + 0.5);
+
+    std::vector<float> resampledAudio(numOutputFrames); // Resampled mono audio
+
+    const float *inputBuffer = mono_audio.data();
+    float *outputBuffer = resampledAudio.data();
+
+    int inputFramesLeft = numInputFrames;
+    int numResampledFrames = 0;
+
+    while (inputFramesLeft > 0 && numResampledFrames < numOutputFrames)
+    {
+        if (resampler->isWriteNeeded())
+        {
+            resampler->writeNextFrame(inputBuffer);
+            inputBuffer++;
+            inputFramesLeft--;
+        }
+        else
+        {
+            resampler->readNextFrame(outputBuffer);
+            outputBuffer++;
+            numResampledFrames++;
+        }
+    }
+
+    while (!resampler->isWriteNeeded() && numResampledFrames < numOutputFrames)
+    {
+        resampler->readNextFrame(outputBuffer);
+        outputBuffer++;
+        numResampledFrames++;
+    }
+
+    return resampledAudio;
+}
+
+std::vector<float>
+basic_pitch::downmix_weights(int channel_count, const DownmixOptions &options)
+{
+    std::vector<int> used = options.channels;
+    if (used.empty())
+    {
+        used.resize(channel_count);
+        std::iota(used.begin(), used.end(), 0);
+    }
+
+    for (int channel : used)
+    {
+        if (channel < 0 || channel >= channel_count)
+        {
+            throw std::runtime_error(
+                "downmix channel " + std::to_string(channel) +
+                " out of range for " + std::to_string(channel_count) +
+                "-channel input");
+        }
+    }
+
+    if (!options.weights.empty() && options.weights.size() != used.size())
+    {
+        throw std::runtime_error(
+            "downmix needs one weight per selected channel");
+    }
+
+    std::vector<float> weights(channel_count, 0.0f);
+    for (std::size_t i = 0; i < used.size(); ++i)
+    {
+        weights[used[i]] += options.weights.empty()
+                                ? 1.0f / static_cast<float>(used.size())
+                                : options.weights[i];
+    }
+    return weights;
+}
+
+void basic_pitch::downmix_to_mono(const float *interleaved,
+                                  std::size_t n_frames,
+                                  const std::vector<float> &weights,
+                                  float *mono)
+{
+    const int channels = weights.size();
+
+    if (channels == 1 && weights[0] == 1.0f)
+    {
+        if (mono != interleaved)
+        {
+            std::copy(interleaved, interleaved + n_frames, mono);
+        }
+        return;
+    }
+
+    // One weighted sum per frame, written straight into mono. Frame i is
+    // read before mono[i] is written, and mono[i] never lies past the start
+    // of frame i, which is what makes in-place use safe.
+    if (channels == 2)
+    {
+        const float w0 = weights[0];
+        const float w1 = weights[1];
+        for (std::size_t i = 0; i < n_frames; ++i)
+        {
+            mono[i] = w0 * interleaved[2 * i] + w1 * interleaved[2 * i + 1];
+        }
+        return;
+    }
+
+    for (std::size_t i = 0; i < n_frames; ++i)
+    {
+        const float *frame = interleaved + i * channels;
+        float sum = 0.0f;
+        for (int c = 0; c < channels; ++c)
+        {
+            sum += weights[c] * frame[c];
+        }
+        mono[i] = sum;
+    }
+}
+
+bool basic_pitch::is_supported_audio_file(const std::string &filename)
+{
+    nqr::NyquistIO loader;
+    return loader.IsFileSupported(filename);
+}
+
+std::vector<float> basic_pitch::load_audio_file(const std::string &filename,
+                                                bool verbose,
+                                                AudioLoadStats *stats,
+                                                const DownmixOptions &downmix)
+{
+    if (!is_supported_audio_file(filename))
+    {
+        throw std::runtime_error("unsupported audio format: " + filename);
+    }
+
+    // decode with libnyquist (wav, flac, mp3, ogg, opus, ...) in-process
+    auto decode_start = Clock::now();
+    nqr::AudioData fileData;
+    {
+        BP_TRACE_SCOPE("decode");
+        nqr::NyquistIO loader;
+        loader.Load(&fileData, filename);
+    }
+    double decode_seconds = seconds_since(decode_start);
+
+    if (verbose)
+    {
+        std::cout << "Input samples: "
+                  << fileData.samples.size() / fileData.channelCount
+                  << std::endl;
+        std::cout << "Length in seconds: " << fileData.lengthSeconds
+                  << std::endl;
+        std::cout << "Number of channels: " << fileData.channelCount
+                  << std::endl;
+    }
+
+    std::vector<float> weights =
+        downmix_weights(fileData.channelCount, downmix);
+
+    auto downmix_start = Clock::now();
+
+    // number of samples per channel
+    std::size_t N = fileData.samples.size() / fileData.channelCount;
+
+    // downmix any channel count into the front of the decode buffer itself,
+    // so multichannel input needs no second full-length buffer
+    std::vector<float> mono_audio = std::move(fileData.samples);
+    downmix_to_mono(mono_audio.data(), N, weights, mono_audio.data());
+    mono_audio.resize(N);
+    double downmix_seconds = seconds_since(downmix_start);
+
+    double resample_seconds = 0.0;
+
+    // Check if resampling is needed
+    if (fileData.sampleRate != SAMPLE_RATE)
+    {
+        if (verbose)
+        {
+            std::cout << "Resampling from " << fileData.sampleRate
+                      << " Hz to " << SAMPLE_RATE << " Hz" << std::endl;
+        }
+
+        auto resample_start = Clock::now();
+        mono_audio = resample_to_model_rate(mono_audio, fileData.sampleRate);
+        resample_seconds = seconds_since(resample_start);
+    }
+    else if (fileData.channelCount > 1)
+    {
+        // drop the spare multichannel capacity before the audio is kept
+        // around for inference
+        mono_audio.shrink_to_fit();
+    }
+
+    if (stats)
+    {
+        stats->source_sample_rate = fileData.sampleRate;
+        stats->source_channels = fileData.channelCount;
+        stats->source_frames = N;
+        stats->length_seconds = fileData.lengthSeconds;
+        stats->decode_seconds = decode_seconds;
+        stats->downmix_seconds = downmix_seconds;
+        stats->resample_seconds = resample_seconds;
+    }
+
+    return mono_audio;
+}
+
+std::vector<float> basic_pitch::read_raw_pcm(std::FILE *stream,
+                                             const RawPcmFormat &format,
+                                             bool verbose,
+                                             const DownmixOptions &downmix)
+{
+    if (format.channels < 1 || format.sample_rate < 1)
+    {
+        throw std::runtime_error("raw PCM needs a positive rate and channels");
+    }
+
+    const std::size_t bytes_per_sample =
+        format.encoding == RawPcmFormat::S16LE ? 2 : 4;
+    const std::size_t frame_bytes = bytes_per_sample * format.channels;
+    const std::size_t block_frames = 4096;
+    const std::vector<float> weights = downmix_weights(format.channels, downmix);
+
+    std::vector<uint8_t> block(block_frames * frame_bytes);
+    std::vector<float> samples(block_frames * format.channels);
+    std::vector<float> mono_audio;
+    std::size_t pending = 0; // bytes of a partial frame carried over
+
+    // the reads are the decode stage here (blocking on a pipe included)
+    {
+        BP_TRACE_SCOPE("decode");
+        while (true)
+        {
+            std::size_t got = std::fread(block.data() + pending, 1,
+                                         block.size() - pending, stream);
+            std::size_t available = pending + got;
+            std::size_t frames = available / frame_bytes;
+
+            std::size_t offset = mono_audio.size();
+            mono_audio.resize(offset + frames);
+
+            std::size_t n_samples = frames * format.channels;
+            if (format.encoding == RawPcmFormat::S16LE)
+            {
+                for (std::size_t i = 0; i < n_samples; ++i)
+                {
+                    int16_t sample;
+                    std::memcpy(&sample, block.data() + i * 2, 2);
+                    samples[i] = sample / 32768.0f;
+                }
+            }
+            else
+            {
+                std::memcpy(samples.data(), block.data(), n_samples * 4);
+            }
+
+            downmix_to_mono(samples.data(), frames, weights,
+                            mono_audio.data() + offset);
+
+            pending = available - frames * frame_bytes;
+            std::memmove(block.data(), block.data() + frames * frame_bytes,
+                         pending);
+
+            if (got == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    if (std::ferror(stream))
+    {
+        throw std::runtime_error("error reading raw PCM input");
+    }
+
+    if (verbose)
+    {
+        std::cout << "Input samples: " << mono_audio.size() << std::endl;
+        std::cout << "Number of channels: " << format.channels << std::endl;
+    }
+
+    if (format.sample_rate != SAMPLE_RATE)
+    {
+        if (verbose)
+        {
+            std::cout << "Resampling from " << format.sample_rate
+                      << " Hz to " << SAMPLE_RATE << " Hz" << std::endl;
+        }
+        return resample_to_model_rate(mono_audio, format.sample_rate);
+    }
+
+    return mono_audio;
+}
@@ -0,0 +1,81 @@
+#ifndef BASIC_PITCH_AUDIO_LOADER_HPP
+#define BASIC_PITCH_AUDIO_LOADER_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace basic_pitch
+{
+// Timings and source properties collected while loading a file
+struct AudioLoadStats
+{
+    int source_sample_rate = 0;
+    int source_channels = 0;
+    std::size_t source_frames = 0;
+    double length_seconds = 0.0;
+    double decode_seconds = 0.0;   // libnyquist decode incl. file read
+    double downmix_seconds = 0.0;  // interleaved -> mono
+    double resample_seconds = 0.0; // source rate -> SAMPLE_RATE
+};
+
+// Headerless PCM as produced by e.g. `ffmpeg -f f32le` or `sox -t raw`
+struct RawPcmFormat
+{
+    enum Encoding
+    {
+        F32LE,
+        S16LE
+    };
+
+    int sample_rate = 22050;
+    int channels = 1;
+    Encoding encoding = F32LE;
+};
+
+// Channel selection / weighting applied when folding N channels to mono.
+// Empty means an equal-weight average of every channel. If channels is set,
+// only those (0-based) channels are used; weights, if set, must have one
+// entry per used channel and are applied as-is (no normalization).
+struct DownmixOptions
+{
+    std::vector<int> channels;
+    std::vector<float> weights;
+};
+
+// Resolve DownmixOptions into one weight per input channel (zero for
+// unselected channels). Throws std::runtime_error on invalid options.
+std::vector<float> downmix_weights(int channel_count,
+                                   const DownmixOptions &options);
+
+// Deinterleave-and-weight n_frames frames of channel_count samples into
+// mono, one frame at a time; mono may alias interleaved as long as
+// mono <= interleaved, so the decode buffer can be downmixed in place.
+void downmix_to_mono(const float *interleaved, std::size_t n_frames,
+                     const std::vector<float> &weights, float *mono);
+
+// True if libnyquist has a decoder for the file extension
+// (wav, flac, mp3, ogg, opus, wv, mpc)
+bool is_supported_audio_file(const std::string &filename);
+
+// Decode any libnyquist-supported file in-process, downmix it to mono in
+// the decode buffer and resample it to the model sample rate. Throws
+// std::runtime_error on unsupported formats or invalid downmix options.
+std::vector<float> load_audio_file(const std::string &filename,
+                                   bool verbose = false,
+                                   AudioLoadStats *stats = nullptr,
+                                   const DownmixOptions &downmix = {});
+
+// Read interleaved raw PCM from a stream (stdin or a named pipe) until EOF,
+// downmixing block by block so the interleaved input is never held in full,
+// then resample to the model sample rate
+std::vector<float> read_raw_pcm(std::FILE *stream, const RawPcmFormat &format,
+                                bool verbose = false,
+                                const DownmixOptions &downmix = {});
+
+// Resample mono audio from sample_rate to the model sample rate
+std::vector<float> resample_to_model_rate(const std::vector<float> &mono_audio,
+                                          int sample_rate);
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_AUDIO_LOADER_HPP
@@ -1,5 +1,9 @@
 #include "basicpitch.hpp"
-#include "MultiChannelResampler.h"
+#include "audio_loader.hpp"
+#include "engine.hpp"
+#include "note_formats.hpp"
+#include "sweep.hpp"
+#include "trace.hpp"
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
@@ -7,127 +11,112 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <libnyquist/Common.h>
-#include <libnyquist/Decoders.h>
-#include <libnyquist/Encoders.h>
 #include <map>
+#include <memory>
 #include <numeric>
 #include <ranges>
 #include <sstream>
 #include <stddef.h>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 #include <getopt.h>
+#include <cstdio>
 
-using namespace nqr;
 using namespace basic_pitch::constants;
 
-static std::vector<float> load_audio_file(std::string filename)
+// Input/output selection parsed alongside the BasicPitchConfig
+struct CliOptions
 {
-    // load a wav file with libnyquist
-    std::shared_ptr<AudioData> fileData = std::make_shared<AudioData>();
-    NyquistIO loader;
-    loader.Load(fileData.get(), filename);
-
-    std::cout << "Input samples: "
-              << fileData->samples.size() / fileData->channelCount << std::endl;
-    std::cout << "Length in seconds: " << fileData->lengthSeconds << std::endl;
-    std::cout << "Number of channels: " << fileData->channelCount << std::endl;
-
-    if (fileData->channelCount != 2 && fileData->channelCount != 1)
-    {
-        std::cerr
-            << "[ERROR] basicpitch.cpp only supports mono and stereo audio"
-            << std::endl;
-        exit(1);
-    }
-
-    // number of samples per channel
-    std::size_t N = fileData->samples.size() / fileData->channelCount;
-
-    std::vector<float> mono_audio(N);
-
-    if (fileData->channelCount == 1)
+    std::string input_file; // "-" reads raw PCM from stdin
+    std::string out_dir;    // "-" writes the MIDI file to stdout
+    basic_pitch::OutputFormat format = basic_pitch::OutputFormat::MIDI;
+    bool raw_input = false;
+    basic_pitch::RawPcmFormat raw_format;
+    basic_pitch::DownmixOptions downmix;
+    basic_pitch::SweepGrid sweep;
+    bool sweep_mode = false; // set if any sweep list is given
+    std::string model_file;  // empty: the embedded model
+    std::string trace_file;  // empty: no tracing
+};
+
+// long-only options
+enum
+{
+    OPT_SWEEP_ONSET = 256,
+    OPT_SWEEP_FRAME,
+    OPT_SWEEP_MIN_LENGTH,
+    OPT_MODEL,
+    OPT_TRACE
+};
+
+// Parse a comma-separated list such as "0,2,3" or "0.5,0.25,0.25"; exits
+// with an error naming option on an empty, non-numeric or (for integer
+// lists) fractional item
+template <typename T>
+static std::vector<T> parse_list(const char *option, const std::string &text)
+{
+    std::vector<T> values;
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ','))
     {
-        for (std::size_t i = 0; i < N; ++i)
+        double value = 0.0;
+        std::size_t parsed = 0;
+        try
         {
-            mono_audio[i] = fileData->samples[i];
+            value = std::stod(item, &parsed);
         }
-    }
-    else
-    {
-        // Stereo case: downmix to mono
-        for (std::size_t i = 0; i < N; ++i)
+        catch (const std::exception &)
+        {
+            parsed = 0;
+        }
+        if (parsed == 0 || parsed != item.size() ||
+            (std::is_integral_v<T> && value != std::floor(value)))
         {
-            mono_audio[i] =
-                (fileData->samples[2 * i] + fileData->samples[2 * i + 1]) /
-                2.0f;
+            std::cerr << "Error: " << option << " expects a comma-separated list of "
+                      << (std::is_integral_v<T> ? "integers" : "numbers")
+                      << ", got \"" << text << "\"\n";
+            exit(1);
         }
+        values.push_back(static_cast<T>(value));
     }
-
-    // Check if resampling is needed
-    if (fileData->sampleRate != SAMPLE_RATE)
+    if (values.empty() || text.back() == ',')
     {
-        std::cout << "Resampling from " << fileData->sampleRate << " Hz to "
-                  << SAMPLE_RATE << " Hz" << std::endl;
-
-        // Resampling using Oboe's resampler module
-        aaudio::resampler::MultiChannelResampler *resampler =
-            aaudio::resampler::MultiChannelResampler::make(
-                1, // Mono (1 channel)
-                fileData->sampleRate, SAMPLE_RATE,
-                aaudio::resampler::MultiChannelResampler::Quality::Best);
-
-        int numInputFrames =
-            N; // Since the audio is mono, numInputFrames is just N
-        int numOutputFrames =
-            static_cast<int>(static_cast<double>(numInputFrames) * SAMPLE_RATE /
-                                 fileData->sampleRate +
-                             0.5);
-
-        std::vector<float> resampledAudio(
-            numOutputFrames); // Resampled mono audio
-
-        float *inputBuffer = mono_audio.data();
-        float *outputBuffer = resampledAudio.data();
-
-        int inputFramesLeft = numInputFrames;
-        int numResampledFrames = 0;
+        std::cerr << "Error: " << option << " expects a comma-separated list, got \""
+                  << text << "\"\n";
+        exit(1);
+    }
+    return values;
+}
 
-        while (inputFramesLeft > 0 && numResampledFrames < numOutputFrames)
+// Same as parse_list, for sweep values, which must lie in [lo, hi] like the
+// single-value option they sweep; repeated values are dropped
+template <typename T>
+static std::vector<T> parse_sweep_list(const char *option, const std::string &text,
+                                       T lo, T hi)
+{
+    std::vector<T> values;
+    for (T value : parse_list<T>(option, text))
+    {
+        if (value < lo || value > hi)
         {
-            if (resampler->isWriteNeeded())
-            {
-                resampler->writeNextFrame(inputBuffer);
-                inputBuffer++;
-                inputFramesLeft--;
-            }
-            else
-            {
-                resampler->readNextFrame(outputBuffer);
-                outputBuffer++;
-                numResampledFrames++;
-            }
+            std::cerr << "Error: " << option << " values must be between " << lo
+                      << " and " << hi << "\n";
+            exit(1);
         }
-
-        while (!resampler->isWriteNeeded() &&
-               numResampledFrames < numOutputFrames)
+        if (std::find(values.begin(), values.end(), value) == values.end())
         {
-            resampler->readNextFrame(outputBuffer);
-            outputBuffer++;
-            numResampledFrames++;
+            values.push_back(value);
         }
-
-        delete resampler;
-
-        return resampledAudio;
     }
-
-    return mono_audio;
+    return values;
 }
 
 void print_usage(const char* program_name) {
-    std::cout << "Usage: " << program_name << " [OPTIONS] <wav_file> <out_dir>\n"
+    std::cout << "Usage: " << program_name << " [OPTIONS] <audio_file> <out_dir>\n"
+              << "  <audio_file> may be wav, flac, mp3, ogg or opus, or - for raw PCM on stdin\n"
+              << "  <out_dir> may be - to write the output file to stdout (logs go to stderr)\n"
               << "Options:\n"
               << "  --onset-threshold FLOAT    Onset detection threshold (0.1-1.0, default: 0.5)\n"
               << "  --frame-threshold FLOAT    Frame threshold for note continuation (0.1-1.0, default: 0.3)\n"
@@ -137,10 +126,30 @@ void print_usage(const char* program_name) {
               << "  --tempo FLOAT              MIDI tempo in BPM (60-200, default: 120)\n"
               << "  --no-melodia-trick         Disable melodia trick\n"
               << "  --no-pitch-bends           Disable pitch bends\n"
+              << "  --simplify-bends           Drop pitch bends that repeat the previous value\n"
+              << "  --bend-tolerance FLOAT     Also simplify bend curves to within FLOAT bend units\n"
+              << "                             (4096 per semitone, implies --simplify-bends)\n"
+              << "  --format FMT               Output: midi, bin (fixed-width note records), csv or jsonl\n"
+              << "                             (default: midi)\n"
+              << "  --raw                      Treat <audio_file> as raw PCM (e.g. a named pipe)\n"
+              << "  --rate INT                 Raw PCM sample rate in Hz (default: 22050)\n"
+              << "  --channels INT             Raw PCM interleaved channel count (default: 1)\n"
+              << "  --pcm-format FMT           Raw PCM encoding: f32le or s16le (default: f32le)\n"
+              << "  --channel-select LIST      Comma-separated 0-based channels to downmix (default: all)\n"
+              << "  --channel-weights LIST     Comma-separated weight per used channel (default: equal average)\n"
+              << "  --sweep-onset LIST         Parameter sweep: comma-separated onset thresholds\n"
+              << "  --sweep-frame LIST         Parameter sweep: comma-separated frame thresholds\n"
+              << "  --sweep-min-length LIST    Parameter sweep: comma-separated min note lengths\n"
+              << "                             (one inference, one output per combination, named\n"
+              << "                             <input>.onset<X>_frame<Y>_len<Z>.<ext>)\n"
+              << "  --model FILE               Load the ORT model from FILE (mapped into memory)\n"
+              << "                             instead of the copy built into the binary\n"
+              << "  --trace FILE               Write per-stage timings as Chrome trace-event JSON\n"
+              << "                             (open in chrome://tracing or ui.perfetto.dev)\n"
               << "  -h, --help                 Show this help message\n";
 }
 
-basic_pitch::BasicPitchConfig parse_arguments(int argc, char* argv[], std::string& wav_file, std::string& out_dir) {
+basic_pitch::BasicPitchConfig parse_arguments(int argc, char* argv[], CliOptions& options) {
     basic_pitch::BasicPitchConfig config;
     
     static struct option long_options[] = {
@@ -152,6 +161,20 @@ basic_pitch::BasicPitchConfig parse_arguments(int argc, char* argv[], std::strin
         {"tempo", required_argument, 0, 't'},
         {"no-melodia-trick", no_argument, 0, 'n'},
         {"no-pitch-bends", no_argument, 0, 'p'},
+        {"simplify-bends", no_argument, 0, 's'},
+        {"bend-tolerance", required_argument, 0, 'T'},
+        {"format", required_argument, 0, 'O'},
+        {"raw", no_argument, 0, 'R'},
+        {"rate", required_argument, 0, 'r'},
+        {"channels", required_argument, 0, 'c'},
+        {"pcm-format", required_argument, 0, 'F'},
+        {"channel-select", required_argument, 0, 'C'},
+        {"channel-weights", required_argument, 0, 'W'},
+        {"sweep-onset", required_argument, 0, OPT_SWEEP_ONSET},
+        {"sweep-frame", required_argument, 0, OPT_SWEEP_FRAME},
+        {"sweep-min-length", required_argument, 0, OPT_SWEEP_MIN_LENGTH},
+        {"model", required_argument, 0, OPT_MODEL},
+        {"trace", required_argument, 0, OPT_TRACE},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -159,7 +182,7 @@ basic_pitch::BasicPitchConfig parse_arguments(int argc, char* argv[], std::strin
     int option_index = 0;
     int c;
     
-    while ((c = getopt_long(argc, argv, "o:f:m:M:l:t:nph", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "o:f:m:M:l:t:npsT:O:Rr:c:F:C:W:h", long_options, &option_index)) != -1) {
         switch (c) {
             case 'o':
                 config.onset_threshold = std::stof(optarg);
@@ -209,6 +232,78 @@ basic_pitch::BasicPitchConfig parse_arguments(int argc, char* argv[], std::strin
             case 'p':
                 config.include_pitch_bends = false;
                 break;
+            case 's':
+                config.simplify_pitch_bends = true;
+                break;
+            case 'T':
+                config.pitch_bend_tolerance = std::stof(optarg);
+                if (config.pitch_bend_tolerance < 0.0f || config.pitch_bend_tolerance > 8192.0f) {
+                    std::cerr << "Error: bend-tolerance must be between 0 and 8192\n";
+                    exit(1);
+                }
+                config.simplify_pitch_bends = true;
+                break;
+            case 'O':
+                if (!basic_pitch::parse_output_format(optarg, options.format)) {
+                    std::cerr << "Error: format must be midi, bin, csv or jsonl\n";
+                    exit(1);
+                }
+                break;
+            case 'R':
+                options.raw_input = true;
+                break;
+            case 'r':
+                options.raw_format.sample_rate = std::stoi(optarg);
+                if (options.raw_format.sample_rate < 1000 || options.raw_format.sample_rate > 384000) {
+                    std::cerr << "Error: rate must be between 1000 and 384000 Hz\n";
+                    exit(1);
+                }
+                break;
+            case 'c':
+                options.raw_format.channels = std::stoi(optarg);
+                if (options.raw_format.channels < 1 || options.raw_format.channels > 64) {
+                    std::cerr << "Error: channels must be between 1 and 64\n";
+                    exit(1);
+                }
+                break;
+            case 'F':
+                if (std::string(optarg) == "f32le") {
+                    options.raw_format.encoding = basic_pitch::RawPcmFormat::F32LE;
+                } else if (std::string(optarg) == "s16le") {
+                    options.raw_format.encoding = basic_pitch::RawPcmFormat::S16LE;
+                } else {
+                    std::cerr << "Error: pcm-format must be f32le or s16le\n";
+                    exit(1);
+                }
+                break;
+            case 'C':
+                options.downmix.channels = parse_list<int>("channel-select", optarg);
+                break;
+            case 'W':
+                options.downmix.weights = parse_list<float>("channel-weights", optarg);
+                break;
+            case OPT_SWEEP_ONSET:
+                options.sweep.onset_thresholds =
+                    parse_sweep_list<float>("sweep-onset", optarg, 0.1f, 1.0f);
+                break;
+            case OPT_SWEEP_FRAME:
+                options.sweep.frame_thresholds =
+                    parse_sweep_list<float>("sweep-frame", optarg, 0.1f, 1.0f);
+                break;
+            case OPT_SWEEP_MIN_LENGTH:
+                options.sweep.min_note_lengths =
+                    parse_sweep_list<int>("sweep-min-length", optarg, 1, 100);
+                break;
+            case OPT_MODEL:
+                options.model_file = optarg;
+                break;
+            case OPT_TRACE:
+                if (!basic_pitch::trace::compiled_in()) {
+                    std::cerr << "Error: --trace needs a build with BASICPITCH_TRACING\n";
+                    exit(1);
+                }
+                options.trace_file = optarg;
+                break;
             case 'h':
                 print_usage(argv[0]);
                 exit(0);
@@ -222,21 +317,69 @@ basic_pitch::BasicPitchConfig parse_arguments(int argc, char* argv[], std::strin
     
     // Check for required positional arguments
     if (optind + 2 != argc) {
-        std::cerr << "Error: Missing required arguments <wav_file> and <out_dir>\n";
+        std::cerr << "Error: Missing required arguments <audio_file> and <out_dir>\n";
         print_usage(argv[0]);
         exit(1);
     }
     
-    wav_file = argv[optind];
-    out_dir = argv[optind + 1];
+    options.input_file = argv[optind];
+    options.out_dir = argv[optind + 1];
+    options.raw_input = options.raw_input || options.input_file == "-";
+
+#ifdef BASIC_PITCH_NO_EMBEDDED_MODEL
+    if (options.model_file.empty()) {
+        std::cerr << "Error: this build has no embedded model, pass --model FILE\n";
+        exit(1);
+    }
+#endif
+
+    options.sweep_mode = !options.sweep.onset_thresholds.empty() ||
+                         !options.sweep.frame_thresholds.empty() ||
+                         !options.sweep.min_note_lengths.empty();
+    if (options.sweep_mode && options.out_dir == "-") {
+        std::cerr << "Error: a parameter sweep writes several files and needs an output directory\n";
+        exit(1);
+    }
     
     return config;
 }
 
+// Writes the events recorded for --trace when main returns
+struct TraceWriter
+{
+    std::string path;
+
+    ~TraceWriter()
+    {
+        if (!path.empty() && !basic_pitch::trace::write_json_file(path))
+        {
+            std::cerr << "Error: unable to write trace " << path << std::endl;
+        }
+    }
+};
+
 int main(int argc, char **argv)
 {
-    std::string wav_file, out_dir;
-    basic_pitch::BasicPitchConfig config = parse_arguments(argc, argv, wav_file, out_dir);
+    CliOptions options;
+    basic_pitch::BasicPitchConfig config = parse_arguments(argc, argv, options);
+
+    TraceWriter trace_writer;
+    if (!options.trace_file.empty())
+    {
+        trace_writer.path = options.trace_file;
+        basic_pitch::trace::enable();
+    }
+    const std::string &wav_file = options.input_file;
+    const std::string &out_dir = options.out_dir;
+
+    // With MIDI on stdout, route all logging (ours and the library's) to
+    // stderr and keep the original stdout buffer for the MIDI bytes
+    bool midi_to_stdout = out_dir == "-";
+    std::streambuf *stdout_buf = std::cout.rdbuf();
+    if (midi_to_stdout)
+    {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
 
     std::cout << "basicpitch.cpp Main driver program" << std::endl;
     std::cout << "Configuration:" << std::endl;
@@ -248,10 +391,14 @@ int main(int argc, char **argv)
     std::cout << "  Tempo: " << config.tempo_bpm << " BPM" << std::endl;
     std::cout << "  Melodia trick: " << (config.use_melodia_trick ? "enabled" : "disabled") << std::endl;
     std::cout << "  Pitch bends: " << (config.include_pitch_bends ? "enabled" : "disabled") << std::endl;
+    if (config.include_pitch_bends && config.simplify_pitch_bends)
+    {
+        std::cout << "  Pitch bend tolerance: " << config.pitch_bend_tolerance << std::endl;
+    }
 
     // Check if the output directory exists, and create it if not
     std::filesystem::path output_dir_path(out_dir);
-    if (!std::filesystem::exists(output_dir_path))
+    if (!midi_to_stdout && !std::filesystem::exists(output_dir_path))
     {
         std::cerr << "Directory does not exist: " << out_dir << ". Creating it."
                   << std::endl;
@@ -262,47 +409,178 @@ int main(int argc, char **argv)
             return 1;
         }
     }
-    else if (!std::filesystem::is_directory(output_dir_path))
+    else if (!midi_to_stdout && !std::filesystem::is_directory(output_dir_path))
     {
         std::cerr << "Error: " << out_dir << " exists but is not a directory!"
                   << std::endl;
         return 1;
     }
 
-    std::cout << "Predicting MIDI for: " << wav_file << std::endl;
+    std::cout << "Predicting MIDI for: "
+              << (wav_file == "-" ? "<stdin>" : wav_file) << std::endl;
 
-    std::vector<float> audio = load_audio_file(wav_file);
+    std::vector<float> audio;
+    try
+    {
+        if (options.raw_input)
+        {
+            // owned closes the file even when read_raw_pcm throws; stdin is
+            // borrowed and left open
+            std::unique_ptr<std::FILE, decltype(&std::fclose)> owned(
+                nullptr, &std::fclose);
+            std::FILE *stream = stdin;
+            if (wav_file != "-")
+            {
+                owned.reset(std::fopen(wav_file.c_str(), "rb"));
+                stream = owned.get();
+            }
+            if (stream == nullptr)
+            {
+                throw std::runtime_error("unable to open " + wav_file);
+            }
+            audio = basic_pitch::read_raw_pcm(stream, options.raw_format,
+                                               true, options.downmix);
+        }
+        else
+        {
+            audio = basic_pitch::load_audio_file(wav_file, true, nullptr,
+                                                 options.downmix);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
 
-    auto inference_result = basic_pitch::ort_inference(audio);
+    basic_pitch::InferenceResult inference_result;
+    if (!options.model_file.empty())
+    {
+        std::unique_ptr<basic_pitch::Engine> engine;
+        try
+        {
+            engine = basic_pitch::Engine::from_file(options.model_file);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[ERROR] " << e.what() << std::endl;
+            return 1;
+        }
+        inference_result = engine->infer(audio);
+    }
+    else
+    {
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+        inference_result = basic_pitch::ort_inference(audio);
+#endif
+    }
 
-    Eigen::Tensor2dXf unwrapped_notes = inference_result.notes;
-    Eigen::Tensor2dXf unwrapped_onsets = inference_result.onsets;
-    Eigen::Tensor2dXf unwrapped_contours = inference_result.contours;
+    std::filesystem::path input_name =
+        std::filesystem::path(wav_file == "-" ? "stdin" : wav_file).filename();
 
-    // Call the function to convert the output to MIDI
-    std::vector<uint8_t> midiBytes =
-        basic_pitch::convert_to_midi(inference_result, config);
+    if (options.sweep_mode)
+    {
+        std::vector<basic_pitch::BasicPitchConfig> sweep_configs =
+            basic_pitch::expand_sweep_grid(config, options.sweep);
+
+        // values that only differ beyond the precision of the file name
+        // would overwrite each other's output
+        std::vector<std::string> labels;
+        std::erase_if(sweep_configs,
+                      [&](const basic_pitch::BasicPitchConfig &sweep_config)
+                      {
+                          std::string label =
+                              basic_pitch::sweep_label(sweep_config);
+                          if (std::ranges::find(labels, label) != labels.end())
+                          {
+                              std::cerr << "Skipping duplicate sweep configuration "
+                                        << label << std::endl;
+                              return true;
+                          }
+                          labels.push_back(label);
+                          return false;
+                      });
+
+        // one inference pass, post-processing for every config in parallel
+        std::cout << "Sweeping " << sweep_configs.size() << " configurations"
+                  << std::endl;
+        std::vector<std::vector<uint8_t>> outputs = basic_pitch::convert_sweep(
+            inference_result, sweep_configs, options.format);
+
+        for (std::size_t i = 0; i < sweep_configs.size(); ++i)
+        {
+            std::filesystem::path output_file = output_dir_path / input_name;
+            output_file.replace_extension(
+                "." + basic_pitch::sweep_label(sweep_configs[i]) +
+                basic_pitch::output_format_extension(options.format));
 
-    // Log the size of the MIDI data
-    std::ostringstream log_message;
-    log_message << "MIDI data size: " << midiBytes.size();
+            {
+                BP_TRACE_SCOPE("file write");
+                std::ofstream output_stream(output_file, std::ios::binary);
+                output_stream.write(
+                    reinterpret_cast<const char *>(outputs[i].data()),
+                    outputs[i].size());
+            }
+            std::cout << "Wrote " << output_file << " (" << outputs[i].size()
+                      << " bytes)" << std::endl;
+        }
+        return 0;
+    }
 
-    std::cout << log_message.str() << std::endl;
+    std::vector<uint8_t> outputBytes;
+    if (options.format == basic_pitch::OutputFormat::MIDI)
+    {
+        // Call the function to convert the output to MIDI
+        basic_pitch::MidiEncodeStats midi_stats;
+        basic_pitch::convert_to_midi(inference_result, config, outputBytes,
+                                     &midi_stats);
+
+        // Log the size of the MIDI data
+        std::ostringstream log_message;
+        log_message << "MIDI data size: " << outputBytes.size() << " ("
+                    << midi_stats.notes << " notes, "
+                    << midi_stats.pitch_bend_events << "/"
+                    << midi_stats.pitch_bends_in << " pitch bends written)";
+
+        std::cout << log_message.str() << std::endl;
+    }
+    else
+    {
+        // notes straight from post-processing, no MIDI encode/decode
+        outputBytes = basic_pitch::convert_to_output(inference_result, config,
+                                                     options.format);
+        std::cout << "Note data size: " << outputBytes.size() << std::endl;
+    }
 
-    // write the midiBytes to a file 'output.mid' in the output directory
-    // we dont need to use libremidi itself since the bytes are already correct
-    // just write the bytes to a file
+    if (midi_to_stdout)
+    {
+        {
+            BP_TRACE_SCOPE("file write");
+            stdout_buf->sputn(
+                reinterpret_cast<const char *>(outputBytes.data()),
+                outputBytes.size());
+            stdout_buf->pubsync();
+        }
+        std::cout.rdbuf(stdout_buf);
+        return 0;
+    }
 
-    // Generate MIDI output file name with .mid extension
-    std::filesystem::path midi_file =
-        output_dir_path / std::filesystem::path(wav_file).filename();
-    midi_file.replace_extension(".mid");
+    // Generate the output file name with the format's extension
+    std::filesystem::path output_file = output_dir_path / input_name;
+    output_file.replace_extension(
+        basic_pitch::output_format_extension(options.format));
 
-    std::ofstream midi_stream(midi_file, std::ios::binary);
-    midi_stream.write(reinterpret_cast<const char *>(midiBytes.data()),
-                      midiBytes.size());
+    {
+        BP_TRACE_SCOPE("file write");
+        std::ofstream output_stream(output_file, std::ios::binary);
+        output_stream.write(reinterpret_cast<const char *>(outputBytes.data()),
+                            outputBytes.size());
+    }
 
-    std::cout << "Wrote MIDI file to: " << midi_file << std::endl;
+    std::cout << "Wrote "
+              << (options.format == basic_pitch::OutputFormat::MIDI ? "MIDI"
+                                                                    : "note")
+              << " file to: " << output_file << std::endl;
 
     return 0;
 }
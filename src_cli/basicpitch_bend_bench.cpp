@@ -0,0 +1,175 @@
+#include "audio_loader.hpp"
+#include "basicpitch.hpp"
+#include "engine.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compares MIDI event counts, file size and encode time with and without
+// pitch bend simplification over a corpus of audio files. Inference runs
+// once per file; every setting encodes the same model output.
+
+struct Setting
+{
+    std::string name;
+    bool simplify;
+    float tolerance;
+};
+
+struct SettingTotals
+{
+    std::size_t notes = 0;
+    std::size_t pitch_bends_in = 0;
+    std::size_t pitch_bend_events = 0;
+    std::size_t midi_bytes = 0;
+    double encode_seconds = 0.0;
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--repeat N] [--tolerances LIST] [--model FILE] "
+                     "<audio_file> [audio_file ...]"
+                  << std::endl;
+        return 1;
+    }
+
+    int repeat = 5;
+    std::vector<float> tolerances = {256.0f, 1024.0f, 2048.0f};
+    std::string model_file;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--tolerances" && i + 1 < argc)
+        {
+            tolerances.clear();
+            std::istringstream iss(argv[++i]);
+            std::string item;
+            while (std::getline(iss, item, ','))
+            {
+                tolerances.push_back(std::stof(item));
+            }
+        }
+        else if (arg == "--model" && i + 1 < argc)
+        {
+            model_file = argv[++i];
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    std::unique_ptr<basic_pitch::Engine> engine;
+    try
+    {
+        if (!model_file.empty())
+        {
+            engine = basic_pitch::Engine::from_file(model_file);
+        }
+        else
+        {
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+            engine = std::make_unique<basic_pitch::Engine>();
+#else
+            std::cerr << "Error: this build has no embedded model; pass "
+                         "--model FILE"
+                      << std::endl;
+            return 1;
+#endif
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<Setting> settings = {{"off", false, 0.0f},
+                                     {"dedupe", true, 0.0f}};
+    for (float tolerance : tolerances)
+    {
+        std::ostringstream name;
+        name << "rdp " << tolerance;
+        settings.push_back({name.str(), true, tolerance});
+    }
+    std::vector<SettingTotals> totals(settings.size());
+
+    // the library logs its progress on std::cout; silence it while timing
+    std::streambuf *cout_buf = std::cout.rdbuf();
+
+    for (const auto &file : files)
+    {
+        std::vector<float> audio;
+        try
+        {
+            audio = basic_pitch::load_audio_file(file);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Skipping " << file << ": " << e.what() << std::endl;
+            continue;
+        }
+
+        std::cout.rdbuf(nullptr);
+        basic_pitch::InferenceResult inference_result = engine->infer(audio);
+
+        std::vector<uint8_t> midi_data;
+        for (std::size_t s = 0; s < settings.size(); ++s)
+        {
+            basic_pitch::BasicPitchConfig config;
+            config.simplify_pitch_bends = settings[s].simplify;
+            config.pitch_bend_tolerance = settings[s].tolerance;
+
+            basic_pitch::MidiEncodeStats stats;
+            double seconds = 0.0;
+            for (int r = 0; r < repeat; ++r)
+            {
+                midi_data.clear();
+                basic_pitch::convert_to_midi(inference_result, config,
+                                             midi_data, &stats);
+                seconds += stats.encode_seconds / repeat;
+            }
+
+            SettingTotals &t = totals[s];
+            t.notes += stats.notes;
+            t.pitch_bends_in += stats.pitch_bends_in;
+            t.pitch_bend_events += stats.pitch_bend_events;
+            t.midi_bytes += midi_data.size();
+            t.encode_seconds += seconds;
+        }
+        std::cout.rdbuf(cout_buf);
+        std::cout.clear();
+    }
+
+    std::cout << std::left << std::setw(12) << "setting" << std::right
+              << std::setw(10) << "notes" << std::setw(14) << "bends in"
+              << std::setw(14) << "bends out" << std::setw(14) << "events"
+              << std::setw(14) << "midi bytes" << std::setw(14)
+              << "encode ms" << std::endl;
+    for (std::size_t s = 0; s < settings.size(); ++s)
+    {
+        const SettingTotals &t = totals[s];
+        std::cout << std::left << std::setw(12) << settings[s].name
+                  << std::right << std::setw(10) << t.notes << std::setw(14)
+                  << t.pitch_bends_in << std::setw(14) << t.pitch_bend_events
+                  << std::setw(14) << 2 * t.notes + t.pitch_bend_events + 1
+                  << std::setw(14) << t.midi_bytes << std::fixed
+                  << std::setprecision(3) << std::setw(14)
+                  << t.encode_seconds * 1000.0 << std::endl;
+    }
+
+    return 0;
+}
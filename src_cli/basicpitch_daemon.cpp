@@ -1,6 +1,11 @@
 #include "basicpitch.hpp"
-#include "model.ort.h"
-#include "MultiChannelResampler.h"
+#include "audio_loader.hpp"
+#include "engine.hpp"
+#include "note_formats.hpp"
+#include "pipeline.hpp"
+#include "resampler_cache.hpp"
+#include "trace.hpp"
+#include "workspace.hpp"
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
@@ -8,9 +13,6 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <libnyquist/Common.h>
-#include <libnyquist/Decoders.h>
-#include <libnyquist/Encoders.h>
 #include <map>
 #include <numeric>
 #include <ranges>
@@ -21,32 +23,64 @@
 #include <thread>
 #include <chrono>
 #include <iomanip>  // for std::quoted
+#include <memory>
+#include <mutex>
 
-using namespace nqr;
 using namespace basic_pitch::constants;
 
-// Global ONNX Runtime components for reuse
-Ort::Env* g_env = nullptr;
-Ort::Session* g_session = nullptr;
+// Global ONNX Runtime session for reuse
+std::unique_ptr<basic_pitch::Engine> g_engine;
 bool model_loaded = false;
 
+// Set by --model; empty loads the model built into the binary
+std::string g_model_file;
+
+// Serializes stdout between the command loop and pipeline completions
+std::mutex g_output_mutex;
+
+// --trace streams to its file, flushed after every file handled so the
+// daemon holds no more than one job's spans; closed when main returns
+struct TraceStream {
+    ~TraceStream() {
+        basic_pitch::trace::close_stream();
+    }
+};
+
+void flush_trace() {
+    if (!basic_pitch::trace::flush_stream()) {
+        std::lock_guard<std::mutex> lock(g_output_mutex);
+        std::cerr << "Error: unable to write trace" << std::endl;
+    }
+}
+
+// Output written by process/enqueue, changed with the 'format' command
+basic_pitch::OutputFormat g_format = basic_pitch::OutputFormat::MIDI;
+
+// Scratch buffers reused by every 'process' request
+basic_pitch::Workspace g_workspace;
+
 // Forward declarations
-static std::vector<float> load_audio_file(std::string filename);
 bool initialize_model();
 void cleanup_model();
 bool process_audio_file(const std::string& wav_file, const std::string& out_dir, const basic_pitch::BasicPitchConfig& config = basic_pitch::BasicPitchConfig{});
+std::unique_ptr<basic_pitch::TranscriptionPipeline> make_pipeline();
+void print_resampler_stats();
+void print_workspace_stats(const basic_pitch::TranscriptionPipeline* pipeline);
 
 bool initialize_model() {
     try {
-        // Initialize ONNX Runtime environment with ERROR level to suppress schema warnings
-        g_env = new Ort::Env(ORT_LOGGING_LEVEL_ERROR, "basic_pitch");
-        
-        // Set session options (use defaults)
-        Ort::SessionOptions session_options;
-        
-        // Create the ONNX Runtime session from the in-memory ORT model
-        g_session = new Ort::Session(*g_env, model_ort_start, model_ort_size, session_options);
-        
+        if (!g_model_file.empty()) {
+            // mapped from disk, so a model update needs no rebuild
+            g_engine = basic_pitch::Engine::from_file(g_model_file);
+        } else {
+#ifdef BASIC_PITCH_NO_EMBEDDED_MODEL
+            std::cerr << "Error loading model: this build has no embedded model, pass --model FILE" << std::endl;
+            return false;
+#else
+            g_engine = std::make_unique<basic_pitch::Engine>();
+#endif
+        }
+
         model_loaded = true;
         std::cout << "Model loaded successfully" << std::endl;
         return true;
@@ -57,19 +91,13 @@ bool initialize_model() {
 }
 
 void cleanup_model() {
-    if (g_session) {
-        delete g_session;
-        g_session = nullptr;
-    }
-    if (g_env) {
-        delete g_env;
-        g_env = nullptr;
-    }
+    g_engine.reset();
     model_loaded = false;
 }
 
 bool process_audio_file(const std::string& wav_file, const std::string& out_dir, const basic_pitch::BasicPitchConfig& config) {
     if (!model_loaded) {
+        std::lock_guard<std::mutex> lock(g_output_mutex);
         std::cerr << "Model not loaded!" << std::endl;
         return false;
     }
@@ -79,44 +107,159 @@ bool process_audio_file(const std::string& wav_file, const std::string& out_dir,
         std::filesystem::path output_dir_path(out_dir);
         if (!std::filesystem::exists(output_dir_path)) {
             if (!std::filesystem::create_directories(output_dir_path)) {
+                std::lock_guard<std::mutex> lock(g_output_mutex);
                 std::cerr << "Error: Unable to create directory: " << out_dir << std::endl;
                 return false;
             }
         }
         
-        std::cout << "Processing: " << wav_file << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            std::cout << "Processing: " << wav_file << std::endl;
+        }
         
-        std::vector<float> audio = load_audio_file(wav_file);
+        // mp3/flac/ogg/opus are decoded in-process, no ffmpeg round-trip
+        std::vector<float> audio = basic_pitch::load_audio_file(wav_file);
         
         // Use the global session for inference
-        auto inference_result = basic_pitch::ort_inference_with_session(*g_session, audio);
+        auto inference_result = g_engine->infer(audio, &g_workspace);
         
-        // Convert to MIDI
-        std::vector<uint8_t> midiBytes = basic_pitch::convert_to_midi(inference_result, config);
+        // Convert to MIDI or notes in the selected format
+        std::vector<uint8_t>& outputBytes = g_workspace.output;
+        std::size_t output_capacity = g_workspace.begin_append(outputBytes);
+        basic_pitch::convert_to_output(inference_result, config, g_format, outputBytes, &g_workspace);
+        g_workspace.used(outputBytes, output_capacity);
         
-        // Generate MIDI output file name with .mid extension
-        std::filesystem::path midi_file = output_dir_path / std::filesystem::path(wav_file).filename();
-        midi_file.replace_extension(".mid");
+        // Generate output file name with the format's extension
+        std::filesystem::path output_file = output_dir_path / std::filesystem::path(wav_file).filename();
+        output_file.replace_extension(basic_pitch::output_format_extension(g_format));
         
-        std::ofstream midi_stream(midi_file, std::ios::binary);
-        midi_stream.write(reinterpret_cast<const char*>(midiBytes.data()), midiBytes.size());
+        {
+            BP_TRACE_SCOPE("file write");
+            std::ofstream output_stream(output_file, std::ios::binary);
+            output_stream.write(reinterpret_cast<const char*>(outputBytes.data()), outputBytes.size());
+        }
         
-        std::cout << "SUCCESS: " << midi_file << " (" << midiBytes.size() << " bytes)" << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            std::cout << "SUCCESS: " << output_file << " (" << outputBytes.size() << " bytes)" << std::endl;
+        }
+        g_workspace.end_job();
+        flush_trace();
         return true;
         
     } catch (const std::exception& e) {
-        std::cerr << "Error processing " << wav_file << ": " << e.what() << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            std::cerr << "Error processing " << wav_file << ": " << e.what() << std::endl;
+        }
+        g_workspace.end_job();
+        flush_trace();
         return false;
     }
 }
 
+void print_resampler_stats() {
+    auto stats = basic_pitch::ResamplerCache::instance().stats();
+    std::cout << "Resamplers: " << stats.created << " created, " << stats.reused << " reused" << std::endl;
+}
+
+void print_workspace_stats(const basic_pitch::TranscriptionPipeline* pipeline) {
+    if (pipeline) {
+        pipeline->print_workspace_stats(std::cout);
+    }
+    g_workspace.print_stats(std::cout, "process");
+}
+
+std::unique_ptr<basic_pitch::TranscriptionPipeline> make_pipeline() {
+    return std::make_unique<basic_pitch::TranscriptionPipeline>(
+        g_engine->session(),
+        [](const std::string& input_file, bool ok, const std::string& message) {
+            flush_trace();
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            if (ok) {
+                std::cout << "DONE " << std::quoted(input_file) << " " << message << std::endl;
+            } else {
+                std::cout << "ERROR " << std::quoted(input_file) << " " << message << std::endl;
+            }
+        });
+}
+
 int main(int argc, const char **argv) {
+    // --model FILE and --trace FILE may precede any mode; drop them from
+    // the arguments
+    TraceStream trace_stream;
+    while (argc >= 3 && (std::string(argv[1]) == "--model" || std::string(argv[1]) == "--trace")) {
+        if (std::string(argv[1]) == "--model") {
+            g_model_file = argv[2];
+        } else {
+            if (!basic_pitch::trace::compiled_in()) {
+                std::cerr << "Error: --trace needs a build with BASICPITCH_TRACING" << std::endl;
+                return 1;
+            }
+            if (!basic_pitch::trace::open_stream(argv[2])) {
+                std::cerr << "Error: unable to write trace " << argv[2] << std::endl;
+                return 1;
+            }
+            basic_pitch::trace::enable();
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
     if (argc < 2) {
         std::cerr << "Usage:" << std::endl;
         std::cerr << "  Single file: " << argv[0] << " <wav file> <out dir>" << std::endl;
+        std::cerr << "  Batch mode:  " << argv[0] << " --batch <out dir> [--format midi|bin|csv|jsonl] <file> [file ...]" << std::endl;
         std::cerr << "  Daemon mode: " << argv[0] << " --daemon <out dir>" << std::endl;
+        std::cerr << "  Any mode may start with --model <model.ort> to load the model from a file" << std::endl;
+        std::cerr << "  and --trace <trace.json> to stream per-stage timings (Chrome trace-event JSON) after each file" << std::endl;
         exit(1);
     }
+
+    // Batch mode: pipeline decode / inference / MIDI write across files
+    if (argc >= 4 && std::string(argv[1]) == "--batch") {
+        std::string out_dir = argv[2];
+
+        if (!initialize_model()) {
+            return 1;
+        }
+
+        int failures = 0;
+        {
+            auto pipeline = std::make_unique<basic_pitch::TranscriptionPipeline>(
+                g_engine->session(),
+                [&failures](const std::string& input_file, bool ok, const std::string& message) {
+                    flush_trace();
+                    std::lock_guard<std::mutex> lock(g_output_mutex);
+                    if (ok) {
+                        std::cout << "SUCCESS: " << message << std::endl;
+                    } else {
+                        std::cerr << "Error processing " << input_file << ": " << message << std::endl;
+                        failures++;
+                    }
+                });
+
+            for (int i = 3; i < argc; ++i) {
+                if (std::string(argv[i]) == "--format" && i + 1 < argc) {
+                    if (!basic_pitch::parse_output_format(argv[++i], g_format)) {
+                        std::cerr << "Unknown format: " << argv[i] << std::endl;
+                        failures++;
+                    }
+                    continue;
+                }
+                pipeline->submit(argv[i], out_dir, basic_pitch::BasicPitchConfig{}, g_format);
+            }
+            pipeline->wait_idle();
+            pipeline->print_occupancy(std::cout);
+            pipeline->print_workspace_stats(std::cout);
+            print_resampler_stats();
+        }
+
+        cleanup_model();
+        return failures == 0 ? 0 : 1;
+    }
     
     // Check for daemon mode
     if (argc == 3 && std::string(argv[1]) == "--daemon") {
@@ -134,12 +277,23 @@ int main(int argc, const char **argv) {
         std::cout << "Ready for commands. Type 'quit' to exit." << std::endl;
         std::cout << "Commands:" << std::endl;
         std::cout << "  process <input_file_path> <output_directory>" << std::endl;
+        std::cout << "    (wav, flac, mp3, ogg and opus are decoded in-process)" << std::endl;
+        std::cout << "  enqueue <input_file_path> <output_directory>" << std::endl;
+        std::cout << "    (pipelined; replies DONE/ERROR per file when written)" << std::endl;
+        std::cout << "  wait     block until all enqueued files are done, then READY" << std::endl;
+        std::cout << "  stats    print pipeline stage occupancy, buffer and resampler reuse" << std::endl;
+        std::cout << "  format <midi|bin|csv|jsonl>" << std::endl;
+        std::cout << "    (output of later process/enqueue commands, default midi)" << std::endl;
         std::cout << "  quit" << std::endl;
         
+        // created on the first enqueue so 'process'-only clients pay nothing
+        std::unique_ptr<basic_pitch::TranscriptionPipeline> pipeline;
+
         std::string line;
         while (true) {
         if (!std::cin.good()) {
             // stdin closed, bail out cleanly
+            std::lock_guard<std::mutex> lock(g_output_mutex);
             std::cout << "Shutting down (stdin closed)..." << std::endl;
             break;
         }
@@ -159,10 +313,65 @@ int main(int argc, const char **argv) {
         if (line.empty()) continue;
 
         if (line == "quit" || line == "exit") {
+            std::lock_guard<std::mutex> lock(g_output_mutex);
             std::cout << "Shutting down..." << std::endl;
             break;
         }
 
+        if (line.substr(0, 7) == "enqueue") {
+            std::istringstream iss(line.length() > 8 ? line.substr(8) : "");
+
+            std::string input_file;
+            std::string output_dir;
+
+            if (!(iss >> std::quoted(input_file))) {
+                std::lock_guard<std::mutex> lock(g_output_mutex);
+                std::cout << "ERROR: Missing input file" << std::endl;
+                continue;
+            }
+            if (!(iss >> std::quoted(output_dir))) {
+                output_dir = out_dir;
+            }
+
+            if (!pipeline) {
+                pipeline = make_pipeline();
+            }
+            pipeline->submit(input_file, output_dir, basic_pitch::BasicPitchConfig{}, g_format);
+            continue;
+        }
+
+        if (line.substr(0, 6) == "format") {
+            std::string name = line.length() > 7 ? line.substr(7) : "";
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            if (basic_pitch::parse_output_format(name, g_format)) {
+                std::cout << "OK format " << name << std::endl;
+            } else {
+                std::cout << "ERROR: Unknown format: " << name << std::endl;
+            }
+            continue;
+        }
+
+        if (line == "wait") {
+            if (pipeline) {
+                pipeline->wait_idle();
+            }
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            std::cout << "READY" << std::endl;
+            continue;
+        }
+
+        if (line == "stats") {
+            std::lock_guard<std::mutex> lock(g_output_mutex);
+            if (pipeline) {
+                pipeline->print_occupancy(std::cout);
+            } else {
+                std::cout << "No files enqueued yet" << std::endl;
+            }
+            print_workspace_stats(pipeline.get());
+            print_resampler_stats();
+            continue;
+        }
+
         if (line.substr(0, 7) == "process") {
             if (line.length() > 8) {
                 std::string args = line.substr(8);
@@ -172,6 +381,7 @@ int main(int argc, const char **argv) {
                 std::string output_dir;
 
                 if (!(iss >> std::quoted(input_file))) {
+                    std::lock_guard<std::mutex> lock(g_output_mutex);
                     std::cout << "ERROR: Missing input file" << std::endl;
                     continue;
                 }
@@ -180,19 +390,21 @@ int main(int argc, const char **argv) {
                     output_dir = out_dir;
                 }
 
-                if (process_audio_file(input_file, output_dir)) {
-                    std::cout << "READY" << std::endl;
-                } else {
-                    std::cout << "ERROR" << std::endl;
-                }
+                bool ok = process_audio_file(input_file, output_dir);
+                std::lock_guard<std::mutex> lock(g_output_mutex);
+                std::cout << (ok ? "READY" : "ERROR") << std::endl;
             } else {
+                std::lock_guard<std::mutex> lock(g_output_mutex);
                 std::cout << "ERROR: No file path provided" << std::endl;
             }
         } else {
+            std::lock_guard<std::mutex> lock(g_output_mutex);
             std::cout << "ERROR: Unknown command: " << line << std::endl;
         }
     }
         
+        // finish outstanding files before the session goes away
+        pipeline.reset();
         cleanup_model();
         return 0;
     }
@@ -220,71 +432,3 @@ int main(int argc, const char **argv) {
     
     return success ? 0 : 1;
 }
-
-// Include the original load_audio_file function
-static std::vector<float> load_audio_file(std::string filename) {
-    // [Previous load_audio_file implementation - keeping it the same]
-    std::shared_ptr<AudioData> fileData = std::make_shared<AudioData>();
-    NyquistIO loader;
-    loader.Load(fileData.get(), filename);
-
-    if (fileData->channelCount != 2 && fileData->channelCount != 1) {
-        std::cerr << "[ERROR] basicpitch.cpp only supports mono and stereo audio" << std::endl;
-        exit(1);
-    }
-
-    std::size_t N = fileData->samples.size() / fileData->channelCount;
-    std::vector<float> mono_audio(N);
-
-    if (fileData->channelCount == 1) {
-        for (std::size_t i = 0; i < N; ++i) {
-            mono_audio[i] = fileData->samples[i];
-        }
-    } else {
-        // Stereo case: downmix to mono
-        for (std::size_t i = 0; i < N; ++i) {
-            mono_audio[i] = (fileData->samples[2 * i] + fileData->samples[2 * i + 1]) / 2.0f;
-        }
-    }
-
-    // Check if resampling is needed
-    if (fileData->sampleRate != SAMPLE_RATE) {
-        // [Resampling code - keeping the same as original]
-        aaudio::resampler::MultiChannelResampler *resampler =
-            aaudio::resampler::MultiChannelResampler::make(
-                1, fileData->sampleRate, SAMPLE_RATE,
-                aaudio::resampler::MultiChannelResampler::Quality::Best);
-
-        int numInputFrames = N;
-        int numOutputFrames = static_cast<int>(static_cast<double>(numInputFrames) * SAMPLE_RATE / fileData->sampleRate + 0.5);
-        std::vector<float> resampledAudio(numOutputFrames);
-
-        float *inputBuffer = mono_audio.data();
-        float *outputBuffer = resampledAudio.data();
-        int inputFramesLeft = numInputFrames;
-        int numResampledFrames = 0;
-
-        while (inputFramesLeft > 0 && numResampledFrames < numOutputFrames) {
-            if (resampler->isWriteNeeded()) {
-                resampler->writeNextFrame(inputBuffer);
-                inputBuffer++;
-                inputFramesLeft--;
-            } else {
-                resampler->readNextFrame(outputBuffer);
-                outputBuffer++;
-                numResampledFrames++;
-            }
-        }
-
-        while (!resampler->isWriteNeeded() && numResampledFrames < numOutputFrames) {
-            resampler->readNextFrame(outputBuffer);
-            outputBuffer++;
-            numResampledFrames++;
-        }
-
-        delete resampler;
-        return resampledAudio;
-    }
-
-    return mono_audio;
-}
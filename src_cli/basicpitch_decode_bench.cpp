@@ -0,0 +1,122 @@
+#include "audio_loader.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Measures in-process decode throughput per container format, to compare
+// against the external ffmpeg -> temp wav -> libnyquist round-trip
+
+struct FormatTotals
+{
+    int files = 0;
+    double file_megabytes = 0.0;
+    double audio_seconds = 0.0;
+    double decode_seconds = 0.0;
+    double downmix_seconds = 0.0;
+    double resample_seconds = 0.0;
+};
+
+static void print_row(const std::string &name, const FormatTotals &t)
+{
+    double total = t.decode_seconds + t.downmix_seconds + t.resample_seconds;
+    std::cout << std::left << std::setw(8) << name << std::right
+              << std::setw(6) << t.files << std::fixed << std::setprecision(2)
+              << std::setw(12) << t.audio_seconds << std::setw(12)
+              << t.decode_seconds * 1000.0 << std::setw(12)
+              << t.downmix_seconds * 1000.0 << std::setw(12)
+              << t.resample_seconds * 1000.0 << std::setw(12)
+              << t.audio_seconds / total << std::setw(12)
+              << t.file_megabytes / t.decode_seconds << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--repeat N] <audio_file> [audio_file ...]"
+                  << std::endl;
+        return 1;
+    }
+
+    int repeat = 3;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    std::map<std::string, FormatTotals> totals;
+    int failed = 0;
+
+    for (const auto &file : files)
+    {
+        std::string ext = std::filesystem::path(file).extension().string();
+        if (!basic_pitch::is_supported_audio_file(file))
+        {
+            std::cerr << "Skipping unsupported format: " << file << std::endl;
+            continue;
+        }
+
+        // one unreadable file is reported and skipped, not fatal to the run;
+        // totals only take a file once every repeat has decoded
+        FormatTotals file_totals;
+        try
+        {
+            double megabytes =
+                std::filesystem::file_size(file) / (1024.0 * 1024.0);
+
+            for (int r = 0; r < repeat; ++r)
+            {
+                basic_pitch::AudioLoadStats stats;
+                basic_pitch::load_audio_file(file, false, &stats);
+
+                file_totals.file_megabytes += megabytes;
+                file_totals.audio_seconds += stats.length_seconds;
+                file_totals.decode_seconds += stats.decode_seconds;
+                file_totals.downmix_seconds += stats.downmix_seconds;
+                file_totals.resample_seconds += stats.resample_seconds;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << file << ": " << e.what() << std::endl;
+            failed++;
+            continue;
+        }
+
+        FormatTotals &t = totals[ext];
+        t.files++;
+        t.file_megabytes += file_totals.file_megabytes;
+        t.audio_seconds += file_totals.audio_seconds;
+        t.decode_seconds += file_totals.decode_seconds;
+        t.downmix_seconds += file_totals.downmix_seconds;
+        t.resample_seconds += file_totals.resample_seconds;
+    }
+
+    std::cout << std::left << std::setw(8) << "format" << std::right
+              << std::setw(6) << "files" << std::setw(12) << "audio_s"
+              << std::setw(12) << "decode_ms" << std::setw(12)
+              << "downmix_ms" << std::setw(12) << "resamp_ms" << std::setw(12)
+              << "x_realtime" << std::setw(12) << "MB/s" << std::endl;
+    for (const auto &[ext, t] : totals)
+    {
+        print_row(ext, t);
+    }
+
+    return failed > 0 ? 1 : 0;
+}
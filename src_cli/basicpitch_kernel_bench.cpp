@@ -0,0 +1,458 @@
+#include "audio_loader.hpp"
+#include "basicpitch.hpp"
+#include "kernels.hpp"
+#include "workspace.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times each post-processing kernel on its own (peak picking, energy walk,
+// melodia, pitch bends, overlap dropping, MIDI encoding), plus the output
+// stitching and the resampler around inference, over synthetic
+// posteriorgrams of several lengths and note densities. Inputs are generated
+// from a fixed seed, so runs before and after a change see the same data;
+// no model or audio files are needed.
+
+using namespace basic_pitch::constants;
+
+static const int N_NOTE_BINS = 88;
+static const int N_CONTOUR_BINS = 264;
+// frames per model window, as in the model output before stitching
+static const int N_CHUNK_FRAMES = 172;
+
+struct Timing
+{
+    double median_ms = 0.0;
+    double min_ms = 0.0;
+};
+
+// One warm-up round, then repeat timed rounds; setup runs before every
+// round and is not timed. With repeat 0 the kernel only runs once, to give
+// the next stage its input.
+static Timing time_kernel(int repeat, const std::function<void()> &setup,
+                          const std::function<void()> &body)
+{
+    std::vector<double> ms;
+    for (int r = -1; r < repeat; ++r)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double elapsed = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        if (r >= 0)
+        {
+            ms.push_back(elapsed);
+        }
+    }
+    Timing timing;
+    if (ms.empty())
+    {
+        return timing;
+    }
+    std::sort(ms.begin(), ms.end());
+    std::size_t mid = ms.size() / 2;
+    timing.median_ms =
+        ms.size() % 2 ? ms[mid] : (ms[mid - 1] + ms[mid]) / 2.0;
+    timing.min_ms = ms.front();
+    return timing;
+}
+
+// Number of model frames for n_samples of audio, as stitched by
+// unwrap_output
+static int frames_for_samples(int n_samples)
+{
+    return static_cast<int>(std::floor(
+        n_samples * (ANNOTATIONS_FPS / static_cast<float>(SAMPLE_RATE))));
+}
+
+// Model output for seconds of audio holding notes_per_second notes of random
+// pitch, start and length over a low noise floor. A fifth of the notes have
+// no onset peak, for the melodia pass to find; contours follow each note
+// with a 5 Hz vibrato.
+static basic_pitch::InferenceResult
+synth_posteriorgram(double seconds, double notes_per_second)
+{
+    int n_frames =
+        frames_for_samples(static_cast<int>(seconds * SAMPLE_RATE));
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> noise(0.0f, 0.08f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    basic_pitch::InferenceResult result;
+    result.notes.resize(n_frames, N_NOTE_BINS);
+    result.onsets.resize(n_frames, N_NOTE_BINS);
+    result.contours.resize(n_frames, N_CONTOUR_BINS);
+    for (Eigen::Index i = 0; i < result.notes.size(); ++i)
+    {
+        result.notes.data()[i] = noise(rng);
+        result.onsets.data()[i] = 0.5f * noise(rng);
+    }
+    for (Eigen::Index i = 0; i < result.contours.size(); ++i)
+    {
+        result.contours.data()[i] = noise(rng);
+    }
+    if (n_frames < 3)
+    {
+        return result;
+    }
+
+    auto raise = [](Eigen::Tensor2dXf &tensor, int t, int bin, float value)
+    {
+        if (bin >= 0 && bin < tensor.dimension(1))
+        {
+            tensor(t, bin) = std::max(tensor(t, bin), value);
+        }
+    };
+
+    std::uniform_int_distribution<int> pitch_dist(15, 75);
+    std::uniform_int_distribution<int> start_dist(1, n_frames - 2);
+    std::uniform_int_distribution<int> length_dist(8, 90);
+    int n_notes = static_cast<int>(std::round(seconds * notes_per_second));
+    for (int n = 0; n < n_notes; ++n)
+    {
+        int pitch = pitch_dist(rng);
+        int start = start_dist(rng);
+        int length = length_dist(rng);
+        int end = std::min(start + length, n_frames - 1);
+        float amplitude = 0.5f + 0.45f * unit(rng);
+        bool has_onset = unit(rng) < 0.8f;
+        float phase = 6.2831853f * unit(rng);
+
+        for (int t = start; t < end; ++t)
+        {
+            float level = amplitude * (1.0f - 0.4f * (t - start) /
+                                                  static_cast<float>(length));
+            raise(result.notes, t, pitch, level);
+            raise(result.notes, t, pitch - 1, 0.3f * level);
+            raise(result.notes, t, pitch + 1, 0.3f * level);
+
+            int vibrato = static_cast<int>(std::round(
+                1.5f * std::sin(6.2831853f * 5.0f * t / ANNOTATIONS_FPS +
+                                phase)));
+            int bin = CONTOURS_BINS_PER_SEMITONE * pitch + vibrato;
+            raise(result.contours, t, bin, level);
+            raise(result.contours, t, bin - 1, 0.5f * level);
+            raise(result.contours, t, bin + 1, 0.5f * level);
+        }
+        if (has_onset)
+        {
+            raise(result.onsets, start, pitch, amplitude);
+            raise(result.onsets, start - 1, pitch, 0.3f * amplitude);
+            raise(result.onsets, start + 1, pitch, 0.3f * amplitude);
+        }
+    }
+    return result;
+}
+
+struct Row
+{
+    std::string kernel;
+    double seconds;
+    double density; // negative: the kernel does not depend on it
+    Timing timing;
+    std::size_t items; // peaks, notes, bends, bytes or samples produced
+};
+
+static void print_row(const Row &row, bool csv)
+{
+    std::ostringstream density;
+    if (row.density >= 0.0)
+    {
+        density << row.density;
+    }
+    else
+    {
+        density << "-";
+    }
+
+    if (csv)
+    {
+        std::cout << row.kernel << "," << row.seconds << "," << density.str()
+                  << "," << std::fixed << std::setprecision(4)
+                  << row.timing.median_ms << "," << row.timing.min_ms << ","
+                  << row.items << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        return;
+    }
+    std::cout << std::left << std::setw(20) << row.kernel << std::right
+              << std::setw(10) << row.seconds << std::setw(10)
+              << density.str() << std::fixed << std::setprecision(3)
+              << std::setw(14) << row.timing.median_ms << std::setw(14)
+              << row.timing.min_ms << std::setw(12) << row.items << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+static std::vector<double> parse_list(const char *text)
+{
+    std::vector<double> values;
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        if (!item.empty())
+        {
+            values.push_back(std::stod(item));
+        }
+    }
+    return values;
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 5;
+    std::vector<double> lengths = {10.0, 60.0, 300.0};
+    std::vector<double> densities = {2.0, 8.0, 32.0};
+    std::string filter;
+    bool csv = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--lengths" && i + 1 < argc)
+        {
+            lengths = parse_list(argv[++i]);
+        }
+        else if (arg == "--densities" && i + 1 < argc)
+        {
+            densities = parse_list(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "--csv")
+        {
+            csv = true;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--repeat N] [--lengths SECONDS,...] "
+                         "[--densities NOTES_PER_SECOND,...] [--filter "
+                         "KERNEL] [--csv]"
+                      << std::endl;
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    auto selected = [&filter](const std::string &kernel)
+    { return filter.empty() || kernel.find(filter) != std::string::npos; };
+
+    if (csv)
+    {
+        std::cout << "kernel,seconds,notes_per_second,median_ms,min_ms,items"
+                  << std::endl;
+    }
+    else
+    {
+        std::cout << std::left << std::setw(20) << "kernel" << std::right
+                  << std::setw(10) << "seconds" << std::setw(10) << "notes/s"
+                  << std::setw(14) << "median ms" << std::setw(14) << "min ms"
+                  << std::setw(12) << "items" << std::endl;
+    }
+
+    basic_pitch::BasicPitchConfig config;
+    auto [freq_lo, freq_hi] = basic_pitch::kernels::note_bin_range(config);
+    basic_pitch::Workspace ws;
+
+    for (double seconds : lengths)
+    {
+        int n_samples = static_cast<int>(seconds * SAMPLE_RATE);
+
+        // Stitching the batched model output: depends on the length only
+        if (selected("unwrap_output"))
+        {
+            basic_pitch::kernels::ChunkRange range;
+            range.n_chunks_total = basic_pitch::ort_num_chunks(n_samples);
+            range.first_chunk = 0;
+            range.end_chunk = range.n_chunks_total;
+            range.total_length = n_samples;
+
+            std::vector<float> output_data(
+                static_cast<std::size_t>(range.n_chunks_total) *
+                N_CHUNK_FRAMES * N_NOTE_BINS);
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            for (float &value : output_data)
+            {
+                value = unit(rng);
+            }
+            std::array<int64_t, 3> shape = {range.n_chunks_total,
+                                            N_CHUNK_FRAMES, N_NOTE_BINS};
+            Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
+                OrtArenaAllocator, OrtMemTypeDefault);
+            Ort::Value output = Ort::Value::CreateTensor<float>(
+                memory_info, output_data.data(), output_data.size(),
+                shape.data(), shape.size());
+
+            Eigen::Tensor2dXf unwrapped;
+            Timing timing = time_kernel(
+                repeat, [&] { unwrapped = Eigen::Tensor2dXf(); },
+                [&] {
+                    basic_pitch::kernels::unwrap_output(output, 0, range,
+                                                        unwrapped);
+                });
+            print_row({"unwrap_output", seconds, -1.0, timing,
+                       static_cast<std::size_t>(unwrapped.size())},
+                      csv);
+        }
+
+        // 44.1 kHz to the model rate: depends on the length only
+        if (selected("resample"))
+        {
+            const int source_rate = 44100;
+            std::vector<float> audio(
+                static_cast<std::size_t>(seconds * source_rate));
+            for (std::size_t i = 0; i < audio.size(); ++i)
+            {
+                audio[i] = 0.3f * std::sin(6.2831853f * 440.0f * i /
+                                           static_cast<float>(source_rate));
+            }
+            std::vector<float> resampled;
+            Timing timing = time_kernel(
+                repeat, [&] { resampled = std::vector<float>(); },
+                [&] {
+                    resampled = basic_pitch::resample_to_model_rate(
+                        audio, source_rate);
+                });
+            print_row({"resample", seconds, -1.0, timing, resampled.size()},
+                      csv);
+        }
+
+        for (double density : densities)
+        {
+            basic_pitch::InferenceResult posteriorgram =
+                synth_posteriorgram(seconds, density);
+            int n_frames = posteriorgram.notes.dimension(0);
+            const Eigen::Map<const Eigen::MatrixXf> frames(
+                posteriorgram.notes.data(), n_frames, N_NOTE_BINS);
+            std::vector<float> energy(frames.size());
+            Eigen::Map<Eigen::MatrixXf> remaining_energy(energy.data(),
+                                                         n_frames, N_NOTE_BINS);
+
+            // Each stage is timed on the output of the previous one, which is
+            // kept so that every round starts from the same state
+            std::vector<std::pair<int, int>> peaks;
+            Timing timing = time_kernel(
+                selected("find_peaks") ? repeat : 0, [&] { peaks.clear(); },
+                [&] {
+                    basic_pitch::kernels::find_peaks(posteriorgram.onsets,
+                                                     config.onset_threshold,
+                                                     freq_lo, freq_hi, peaks);
+                });
+            if (selected("find_peaks"))
+            {
+                print_row({"find_peaks", seconds, density, timing,
+                           peaks.size()},
+                          csv);
+            }
+            std::reverse(peaks.begin(), peaks.end());
+
+            basic_pitch::NoteEventTable notes;
+            timing = time_kernel(
+                selected("energy_walk") ? repeat : 0,
+                [&]
+                {
+                    remaining_energy = frames;
+                    notes.clear();
+                },
+                [&]
+                {
+                    basic_pitch::kernels::walk_note_energy(
+                        frames, remaining_energy, peaks,
+                        config.frame_threshold, config.min_note_length,
+                        notes);
+                });
+            if (selected("energy_walk"))
+            {
+                print_row({"energy_walk", seconds, density, timing,
+                           notes.size()},
+                          csv);
+            }
+
+            const std::vector<float> walked_energy = energy;
+            const basic_pitch::NoteEventTable walked_notes = notes;
+            timing = time_kernel(
+                selected("melodia") ? repeat : 0,
+                [&]
+                {
+                    energy = walked_energy;
+                    notes = walked_notes;
+                },
+                [&]
+                {
+                    basic_pitch::kernels::apply_melodia_trick(
+                        remaining_energy, frames, config.frame_threshold,
+                        ENERGY_TOL, config.min_note_length, freq_lo, freq_hi,
+                        notes);
+                });
+            if (selected("melodia"))
+            {
+                print_row({"melodia", seconds, density, timing,
+                           notes.size() - walked_notes.size()},
+                          csv);
+            }
+
+            const basic_pitch::NoteEventTable melodia_notes = notes;
+            timing = time_kernel(
+                selected("add_pitch_bends") ? repeat : 0,
+                [&] { notes = melodia_notes; },
+                [&]
+                {
+                    basic_pitch::kernels::add_pitch_bends(
+                        posteriorgram.contours, notes);
+                });
+            if (selected("add_pitch_bends"))
+            {
+                print_row({"add_pitch_bends", seconds, density, timing,
+                           notes.bends.size()},
+                          csv);
+            }
+
+            const basic_pitch::NoteEventTable bent_notes = notes;
+            timing = time_kernel(
+                selected("drop_overlapping") ? repeat : 0,
+                [&] { notes = bent_notes; },
+                [&]
+                { basic_pitch::kernels::drop_overlapping_pitch_bends(notes); });
+            if (selected("drop_overlapping"))
+            {
+                print_row({"drop_overlapping", seconds, density, timing,
+                           notes.size()},
+                          csv);
+            }
+
+            std::vector<uint8_t> midi_data;
+            timing = time_kernel(
+                selected("midi_encode") ? repeat : 0,
+                [&] { midi_data.clear(); },
+                [&]
+                {
+                    basic_pitch::kernels::note_events_to_midi(
+                        notes, n_frames, config, midi_data, nullptr, ws);
+                });
+            if (selected("midi_encode"))
+            {
+                print_row({"midi_encode", seconds, density, timing,
+                           midi_data.size()},
+                          csv);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,424 @@
+#include "audio_loader.hpp"
+#include "basicpitch.hpp"
+#include "engine.hpp"
+#include "trace.hpp"
+#include "workspace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+// End-to-end throughput over a synthetic corpus: generates deterministic
+// test audio (sine chords, piano-like tones with vibrato, silence, noise) of
+// each requested length and sample rate, runs resampling, inference, note
+// extraction and MIDI encoding through the library, and prints one JSON
+// document with the realtime factor, peak RSS and per-stage times per input.
+// The signals are fully determined by the segment schedule below, so
+// results can be compared release over release.
+
+using namespace basic_pitch::constants;
+
+static const double TWO_PI = 6.283185307179586;
+
+static double midi_to_hz(double pitch)
+{
+    return 440.0 * std::pow(2.0, (pitch - 69.0) / 12.0);
+}
+
+enum class Segment
+{
+    Chord,
+    Melody,
+    Silence,
+    Noise
+};
+
+// The corpus repeats this schedule; each segment's content is drawn from a
+// generator seeded with the segment's index, so a shorter input is always a
+// prefix of a longer one
+static const std::pair<Segment, double> SCHEDULE[] = {
+    {Segment::Chord, 2.0},
+    {Segment::Melody, 3.0},
+    {Segment::Silence, 1.0},
+    {Segment::Chord, 2.0},
+    {Segment::Noise, 1.0},
+    {Segment::Melody, 3.0},
+};
+
+// Three sustained sines of a random major or minor triad
+static void synth_chord(std::mt19937 &rng, int rate, float *out, int n)
+{
+    int root = std::uniform_int_distribution<int>(45, 72)(rng);
+    int third = std::uniform_int_distribution<int>(0, 1)(rng) ? 4 : 3;
+    double hz[] = {midi_to_hz(root), midi_to_hz(root + third),
+                   midi_to_hz(root + 7)};
+    int fade = std::min(n / 2, rate / 100);
+    for (int i = 0; i < n; ++i)
+    {
+        double t = static_cast<double>(i) / rate;
+        double sample = 0.0;
+        for (double f : hz)
+        {
+            sample += std::sin(TWO_PI * f * t);
+        }
+        double envelope = std::min(1.0, std::min(i, n - 1 - i) /
+                                            static_cast<double>(fade + 1));
+        out[i] = static_cast<float>(0.15 * envelope * sample);
+    }
+}
+
+// Half-second notes with decaying harmonics and a 5.5 Hz vibrato
+static void synth_melody(std::mt19937 &rng, int rate, float *out, int n)
+{
+    const int note_length = rate / 2;
+    std::uniform_int_distribution<int> pitch_dist(40, 84);
+    for (int first = 0; first < n; first += note_length)
+    {
+        double pitch = pitch_dist(rng);
+        double f0 = midi_to_hz(pitch);
+        int end = std::min(n, first + note_length);
+        double phase = 0.0;
+        for (int i = first; i < end; ++i)
+        {
+            double t = static_cast<double>(i - first) / rate;
+            // +-30 cents, integrated into the phase to keep it continuous
+            double vibrato =
+                std::pow(2.0, 0.3 / 12.0 * std::sin(TWO_PI * 5.5 * t));
+            phase += TWO_PI * f0 * vibrato / rate;
+            double envelope = std::min(1.0, t / 0.005) * std::exp(-3.0 * t);
+            double sample = 0.0;
+            for (int k = 1; k <= 8; ++k)
+            {
+                sample += std::sin(k * phase) * std::exp(-0.8 * k * t) / k;
+            }
+            out[i] = static_cast<float>(0.3 * envelope * sample);
+        }
+    }
+}
+
+static void synth_noise(std::mt19937 &rng, float *out, int n)
+{
+    std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+    for (int i = 0; i < n; ++i)
+    {
+        out[i] = noise(rng);
+    }
+}
+
+static std::vector<float> synth_corpus(double seconds, int rate)
+{
+    std::vector<float> audio(static_cast<std::size_t>(seconds * rate), 0.0f);
+    const std::size_t n_kinds = sizeof(SCHEDULE) / sizeof(SCHEDULE[0]);
+    std::size_t pos = 0;
+    for (unsigned index = 0; pos < audio.size(); ++index)
+    {
+        auto [kind, segment_seconds] = SCHEDULE[index % n_kinds];
+        int n = static_cast<int>(std::min<std::size_t>(
+            static_cast<std::size_t>(segment_seconds * rate),
+            audio.size() - pos));
+        std::mt19937 rng(index);
+        float *out = audio.data() + pos;
+        switch (kind)
+        {
+        case Segment::Chord:
+            synth_chord(rng, rate, out, n);
+            break;
+        case Segment::Melody:
+            synth_melody(rng, rate, out, n);
+            break;
+        case Segment::Silence:
+            break;
+        case Segment::Noise:
+            synth_noise(rng, out, n);
+            break;
+        }
+        pos += n;
+    }
+    return audio;
+}
+
+// On Linux the peak RSS (VmHWM) can be reset, so each input reports its own
+// peak; elsewhere the value is the peak of the whole process so far
+static bool reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+}
+
+static long long peak_rss_bytes()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmHWM:", 0) == 0)
+        {
+            return std::atoll(line.c_str() + 6) * 1024;
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss; // bytes
+#else
+    return static_cast<long long>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+}
+
+static double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    std::size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid]
+                             : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+static std::vector<double> parse_list(const char *text)
+{
+    std::vector<double> values;
+    std::istringstream iss(text);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        if (!item.empty())
+        {
+            values.push_back(std::stod(item));
+        }
+    }
+    return values;
+}
+
+struct Run
+{
+    double resample_ms = 0.0;
+    double inference_ms = 0.0;
+    double postprocess_ms = 0.0;
+    double total_ms = 0.0;
+    std::size_t notes = 0;
+    std::size_t midi_bytes = 0;
+};
+
+int main(int argc, char **argv)
+{
+    std::vector<double> lengths = {10.0, 60.0, 600.0, 3600.0};
+    std::vector<double> rates = {44100.0};
+    int repeat = 1;
+    int batch_chunks = 32;
+    std::string model_file;
+    std::string out_file;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--lengths" && i + 1 < argc)
+        {
+            lengths = parse_list(argv[++i]);
+        }
+        else if (arg == "--rates" && i + 1 < argc)
+        {
+            rates = parse_list(argv[++i]);
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--batch-chunks" && i + 1 < argc)
+        {
+            batch_chunks = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--model" && i + 1 < argc)
+        {
+            model_file = argv[++i];
+        }
+        else if (arg == "--out" && i + 1 < argc)
+        {
+            out_file = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--lengths SECONDS,...] [--rates HZ,...] [--repeat "
+                         "N] [--batch-chunks N] [--model FILE] [--out FILE]"
+                      << std::endl;
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    auto load_start = std::chrono::steady_clock::now();
+    std::unique_ptr<basic_pitch::Engine> engine;
+    try
+    {
+        if (!model_file.empty())
+        {
+            engine = basic_pitch::Engine::from_file(model_file);
+        }
+        else
+        {
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+            engine = std::make_unique<basic_pitch::Engine>();
+#else
+            std::cerr << "Error: this build has no embedded model; pass "
+                         "--model FILE"
+                      << std::endl;
+            return 1;
+#endif
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    double model_load_ms = ms_since(load_start);
+
+    // per-stage times come from the trace spans when they are compiled in
+    basic_pitch::trace::enable(basic_pitch::trace::compiled_in());
+    basic_pitch::BasicPitchConfig config;
+    basic_pitch::Workspace workspace;
+
+    // the library may log progress on std::cout, which carries the JSON
+    std::streambuf *cout_buf = std::cout.rdbuf();
+    std::ostringstream results;
+    bool first_result = true;
+    for (double rate_value : rates)
+    {
+        int rate = static_cast<int>(rate_value);
+        for (double seconds : lengths)
+        {
+            std::cerr << "synthetic " << seconds << " s at " << rate
+                      << " Hz..." << std::endl;
+            std::vector<float> source = synth_corpus(seconds, rate);
+
+            bool peak_is_per_input = reset_peak_rss();
+            basic_pitch::trace::clear();
+            std::vector<Run> runs;
+            for (int r = 0; r < repeat; ++r)
+            {
+                std::cout.rdbuf(nullptr);
+                Run run;
+                auto start = std::chrono::steady_clock::now();
+
+                std::vector<float> resampled;
+                if (rate != SAMPLE_RATE)
+                {
+                    resampled =
+                        basic_pitch::resample_to_model_rate(source, rate);
+                }
+                const std::vector<float> &audio =
+                    rate != SAMPLE_RATE ? resampled : source;
+                run.resample_ms = ms_since(start);
+
+                auto inference_start = std::chrono::steady_clock::now();
+                basic_pitch::InferenceResult inference_result =
+                    basic_pitch::ort_inference_in_batches(
+                        engine->session(), audio.data(), audio.size(),
+                        batch_chunks, nullptr, &workspace);
+                run.inference_ms = ms_since(inference_start);
+
+                auto postprocess_start = std::chrono::steady_clock::now();
+                std::vector<uint8_t> midi_data;
+                basic_pitch::MidiEncodeStats stats;
+                basic_pitch::convert_to_midi(inference_result, config,
+                                             midi_data, &stats, &workspace);
+                run.postprocess_ms = ms_since(postprocess_start);
+                run.total_ms = ms_since(start);
+                run.notes = stats.notes;
+                run.midi_bytes = midi_data.size();
+                workspace.end_job();
+
+                std::cout.rdbuf(cout_buf);
+                std::cout.clear();
+                runs.push_back(run);
+            }
+            long long peak_rss = peak_rss_bytes();
+
+            auto median_of = [&runs](double Run::*field)
+            {
+                std::vector<double> values;
+                for (const Run &run : runs)
+                {
+                    values.push_back(run.*field);
+                }
+                return median(values);
+            };
+            double total_ms = median_of(&Run::total_ms);
+            std::ostringstream name;
+            name << "synthetic-" << seconds << "s-" << rate << "hz";
+
+            results << (first_result ? "\n" : ",\n") << std::fixed
+                    << std::setprecision(3) << "    {\"input\": \""
+                    << name.str() << "\", \"audio_seconds\": " << seconds
+                    << ", \"source_rate\": " << rate
+                    << ", \"repeats\": " << runs.size()
+                    << ", \"total_ms\": " << total_ms
+                    << ", \"realtime_factor\": " << std::setprecision(6)
+                    << total_ms / 1000.0 / seconds << std::setprecision(3)
+                    << ", \"resample_ms\": " << median_of(&Run::resample_ms)
+                    << ", \"inference_ms\": " << median_of(&Run::inference_ms)
+                    << ", \"postprocess_ms\": "
+                    << median_of(&Run::postprocess_ms)
+                    << ", \"notes\": " << runs.back().notes
+                    << ", \"midi_bytes\": " << runs.back().midi_bytes
+                    << ", \"peak_rss_bytes\": " << peak_rss
+                    << ", \"peak_rss_per_input\": "
+                    << (peak_is_per_input ? "true" : "false")
+                    << ", \"stages\": {";
+            // mean per run of each traced stage
+            std::vector<basic_pitch::trace::SpanTotal> stages =
+                basic_pitch::trace::span_totals();
+            for (std::size_t s = 0; s < stages.size(); ++s)
+            {
+                results << (s > 0 ? ", " : "") << "\"" << stages[s].name
+                        << "\": {\"count\": " << stages[s].count / repeat
+                        << ", \"ms\": "
+                        << stages[s].total_us / 1000.0 / repeat << "}";
+            }
+            results << "}}";
+            first_result = false;
+        }
+    }
+
+    std::ostringstream report;
+    report << "{\n  \"tool\": \"basicpitch_rtf_bench\",\n"
+           << "  \"model\": \""
+           << (model_file.empty() ? "embedded" : "file") << "\",\n"
+           << "  \"batch_chunks\": " << batch_chunks << ",\n"
+           << "  \"hardware_threads\": "
+           << std::thread::hardware_concurrency() << ",\n"
+           << "  \"traced_stages\": "
+           << (basic_pitch::trace::compiled_in() ? "true" : "false") << ",\n"
+           << std::fixed << std::setprecision(3)
+           << "  \"model_load_ms\": " << model_load_ms << ",\n"
+           << "  \"results\": [" << results.str() << "\n  ]\n}\n";
+
+    if (!out_file.empty())
+    {
+        std::ofstream out(out_file);
+        out << report.str();
+        if (!out)
+        {
+            std::cerr << "Error: unable to write " << out_file << std::endl;
+            return 1;
+        }
+    }
+    std::cout << report.str();
+    return 0;
+}
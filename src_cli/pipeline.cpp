@@ -0,0 +1,224 @@
+#include "pipeline.hpp"
+#include "audio_loader.hpp"
+#include "trace.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using Clock = std::chrono::steady_clock;
+
+static const char *STAGE_NAMES[] = {"decode", "inference", "postprocess"};
+
+basic_pitch::TranscriptionPipeline::TranscriptionPipeline(
+    Ort::Session &session, Callback on_done, std::size_t queue_depth)
+    : session_(session), on_done_(std::move(on_done)),
+      decode_queue_(queue_depth), inference_queue_(queue_depth),
+      postprocess_queue_(queue_depth)
+{
+    threads_.emplace_back(&TranscriptionPipeline::decode_loop, this);
+    threads_.emplace_back(&TranscriptionPipeline::inference_loop, this);
+    threads_.emplace_back(&TranscriptionPipeline::postprocess_loop, this);
+}
+
+basic_pitch::TranscriptionPipeline::~TranscriptionPipeline()
+{
+    // closing the first queue drains the pipeline stage by stage
+    decode_queue_.close();
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+void basic_pitch::TranscriptionPipeline::submit(const std::string &input_file,
+                                                const std::string &output_dir,
+                                                const BasicPitchConfig &config,
+                                                OutputFormat format)
+{
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        if (in_flight_++ == 0)
+        {
+            active_since_ = Clock::now();
+        }
+    }
+
+    PipelineJob job;
+    job.input_file = input_file;
+    job.output_dir = output_dir;
+    job.config = config;
+    job.format = format;
+    decode_queue_.push(std::move(job));
+}
+
+void basic_pitch::TranscriptionPipeline::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_cv_.wait(lock, [&] { return in_flight_ == 0; });
+}
+
+void basic_pitch::TranscriptionPipeline::add_busy(Stage stage,
+                                                  Clock::time_point start)
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    busy_seconds_[stage] +=
+        std::chrono::duration<double>(Clock::now() - start).count();
+    jobs_done_[stage]++;
+}
+
+void basic_pitch::TranscriptionPipeline::decode_loop()
+{
+    while (auto job = decode_queue_.pop())
+    {
+        auto start = Clock::now();
+        try
+        {
+            job->audio = load_audio_file(job->input_file);
+        }
+        catch (const std::exception &e)
+        {
+            job->error = e.what();
+        }
+        add_busy(DECODE, start);
+        inference_queue_.push(std::move(*job));
+    }
+    inference_queue_.close();
+}
+
+void basic_pitch::TranscriptionPipeline::inference_loop()
+{
+    while (auto job = inference_queue_.pop())
+    {
+        if (job->error.empty())
+        {
+            auto start = Clock::now();
+            try
+            {
+                job->inference_result = ort_inference_with_session(
+                    session_, job->audio, &inference_workspace_);
+            }
+            catch (const std::exception &e)
+            {
+                job->error = e.what();
+            }
+            inference_workspace_.end_job();
+            // the audio is not needed past this stage
+            std::vector<float>().swap(job->audio);
+            add_busy(INFERENCE, start);
+        }
+        postprocess_queue_.push(std::move(*job));
+    }
+    postprocess_queue_.close();
+}
+
+void basic_pitch::TranscriptionPipeline::postprocess_loop()
+{
+    while (auto job = postprocess_queue_.pop())
+    {
+        std::string message = job->error;
+        bool ok = job->error.empty();
+
+        if (ok)
+        {
+            auto start = Clock::now();
+            try
+            {
+                Workspace &ws = postprocess_workspace_;
+                std::vector<uint8_t> &outputBytes = ws.output;
+                std::size_t output_capacity = ws.begin_append(outputBytes);
+                // inference of the next file runs meanwhile on ORT's
+                // threads, so this stage stays on its own thread
+                BasicPitchConfig config = job->config;
+                config.postprocess_threads = 1;
+                convert_to_output(job->inference_result, config, job->format,
+                                  outputBytes, &ws);
+                ws.used(outputBytes, output_capacity);
+
+                std::filesystem::path output_dir_path(job->output_dir);
+                if (!std::filesystem::exists(output_dir_path))
+                {
+                    std::filesystem::create_directories(output_dir_path);
+                }
+
+                std::filesystem::path output_file =
+                    output_dir_path /
+                    std::filesystem::path(job->input_file).filename();
+                output_file.replace_extension(
+                    output_format_extension(job->format));
+
+                {
+                    BP_TRACE_SCOPE("file write");
+                    std::ofstream output_stream(output_file,
+                                                std::ios::binary);
+                    output_stream.write(
+                        reinterpret_cast<const char *>(outputBytes.data()),
+                        outputBytes.size());
+                }
+
+                message = output_file.string() + " (" +
+                          std::to_string(outputBytes.size()) + " bytes)";
+            }
+            catch (const std::exception &e)
+            {
+                ok = false;
+                message = e.what();
+            }
+            postprocess_workspace_.end_job();
+            add_busy(POSTPROCESS, start);
+        }
+
+        on_done_(job->input_file, ok, message);
+
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            if (--in_flight_ == 0)
+            {
+                active_seconds_ += std::chrono::duration<double>(
+                                       Clock::now() - active_since_)
+                                       .count();
+            }
+        }
+        idle_cv_.notify_all();
+    }
+}
+
+void basic_pitch::TranscriptionPipeline::print_occupancy(
+    std::ostream &out) const
+{
+    double wall = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        wall = active_seconds_;
+        if (in_flight_ > 0)
+        {
+            wall += std::chrono::duration<double>(Clock::now() - active_since_)
+                        .count();
+        }
+    }
+
+    // formatted locally so the caller's stream keeps its flags
+    std::ostringstream table;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        table << "Stage occupancy over " << std::fixed
+              << std::setprecision(2) << wall << " s with files in flight:\n";
+        for (int stage = 0; stage < NUM_STAGES; ++stage)
+        {
+            table << "  " << std::left << std::setw(12) << STAGE_NAMES[stage]
+                  << std::right << std::setw(6) << jobs_done_[stage]
+                  << " jobs " << std::setw(10) << busy_seconds_[stage]
+                  << " s busy " << std::setw(6) << std::setprecision(1)
+                  << (wall > 0.0 ? 100.0 * busy_seconds_[stage] / wall : 0.0)
+                  << "%" << std::setprecision(2) << "\n";
+        }
+    }
+    out << table.str() << std::flush;
+}
+
+void basic_pitch::TranscriptionPipeline::print_workspace_stats(
+    std::ostream &out) const
+{
+    inference_workspace_.print_stats(out, "inference");
+    postprocess_workspace_.print_stats(out, "postprocess");
+}
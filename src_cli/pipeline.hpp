@@ -0,0 +1,153 @@
+#ifndef BASIC_PITCH_PIPELINE_HPP
+#define BASIC_PITCH_PIPELINE_HPP
+
+#include "basicpitch.hpp"
+#include "note_formats.hpp"
+#include "workspace.hpp"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace basic_pitch
+{
+// Fixed-capacity blocking queue used between pipeline stages; push blocks
+// while full so a slow stage applies backpressure to the ones before it
+template <typename T> class BoundedQueue
+{
+  public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    // Returns std::nullopt once the queue is closed and drained
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty())
+        {
+            return std::nullopt;
+        }
+        T item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+  private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+struct PipelineJob
+{
+    std::string input_file;
+    std::string output_dir;
+    BasicPitchConfig config;
+    OutputFormat format = OutputFormat::MIDI;
+
+    std::vector<float> audio;
+    InferenceResult inference_result;
+    std::string error; // non-empty once a stage has failed
+};
+
+// Three-stage transcription pipeline: decode+resample, inference,
+// post-processing+output write (MIDI or a note format). File N+1 decodes while file N is in
+// session.Run and file N-1 is converted to MIDI.
+class TranscriptionPipeline
+{
+  public:
+    enum Stage
+    {
+        DECODE = 0,
+        INFERENCE,
+        POSTPROCESS,
+        NUM_STAGES
+    };
+
+    // Called from the post-processing thread, in submission order
+    using Callback = std::function<void(const std::string &input_file,
+                                        bool ok, const std::string &message)>;
+
+    TranscriptionPipeline(Ort::Session &session, Callback on_done,
+                          std::size_t queue_depth = 2);
+    ~TranscriptionPipeline();
+
+    TranscriptionPipeline(const TranscriptionPipeline &) = delete;
+    TranscriptionPipeline &operator=(const TranscriptionPipeline &) = delete;
+
+    // Blocks while the decode queue is full
+    void submit(const std::string &input_file, const std::string &output_dir,
+                const BasicPitchConfig &config = BasicPitchConfig{},
+                OutputFormat format = OutputFormat::MIDI);
+
+    // Blocks until every submitted job has been written or has failed
+    void wait_idle();
+
+    // Per-stage busy time as a fraction of the time files were in flight;
+    // idle gaps between batches do not count
+    void print_occupancy(std::ostream &out) const;
+
+    // Bytes the inference and post-processing workspaces reused vs
+    // allocated
+    void print_workspace_stats(std::ostream &out) const;
+
+  private:
+    void decode_loop();
+    void inference_loop();
+    void postprocess_loop();
+    void add_busy(Stage stage, std::chrono::steady_clock::time_point start);
+
+    Ort::Session &session_;
+    Callback on_done_;
+
+    BoundedQueue<PipelineJob> decode_queue_;
+    BoundedQueue<PipelineJob> inference_queue_;
+    BoundedQueue<PipelineJob> postprocess_queue_;
+
+    mutable std::mutex stats_mutex_;
+    std::array<double, NUM_STAGES> busy_seconds_{};
+    std::array<int, NUM_STAGES> jobs_done_{};
+
+    // each owned by the one thread running that stage
+    Workspace inference_workspace_;
+    Workspace postprocess_workspace_;
+
+    mutable std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    int in_flight_ = 0;
+    // time with at least one file in flight: closed periods, plus the
+    // start of the current one while in_flight_ > 0
+    double active_seconds_ = 0.0;
+    std::chrono::steady_clock::time_point active_since_;
+
+    std::vector<std::thread> threads_;
+};
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_PIPELINE_HPP
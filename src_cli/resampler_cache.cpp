@@ -0,0 +1,55 @@
+#include "resampler_cache.hpp"
+
+basic_pitch::ResamplerCache &basic_pitch::ResamplerCache::instance()
+{
+    static ResamplerCache cache;
+    return cache;
+}
+
+basic_pitch::ResamplerCache::Lease
+basic_pitch::ResamplerCache::acquire(int channels, int input_rate,
+                                     int output_rate, Quality quality)
+{
+    Lease::Key key{input_rate, output_rate, quality, channels};
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = idle_.find(key);
+        if (it != idle_.end() && !it->second.empty())
+        {
+            std::unique_ptr<Resampler> resampler = std::move(it->second.back());
+            it->second.pop_back();
+            stats_.reused++;
+
+            resampler->reset();
+            return Lease(*this, key, std::move(resampler));
+        }
+        stats_.created++;
+    }
+
+    // build outside the lock, coefficient generation is the slow part
+    std::unique_ptr<Resampler> resampler(
+        Resampler::make(channels, input_rate, output_rate, quality));
+    return Lease(*this, key, std::move(resampler));
+}
+
+void basic_pitch::ResamplerCache::release(const Lease::Key &key,
+                                          std::unique_ptr<Resampler> resampler)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_[key].push_back(std::move(resampler));
+}
+
+basic_pitch::ResamplerCache::Stats basic_pitch::ResamplerCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+basic_pitch::ResamplerCache::Lease::~Lease()
+{
+    if (resampler_)
+    {
+        cache_->release(key_, std::move(resampler_));
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef BASIC_PITCH_RESAMPLER_CACHE_HPP
+#define BASIC_PITCH_RESAMPLER_CACHE_HPP
+
+#include "MultiChannelResampler.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace basic_pitch
+{
+// Process-wide pool of resamplers keyed by (input rate, output rate,
+// quality, channels). Building a resampler computes its windowed-sinc
+// coefficient table; a long-running daemon sees the same few rate pairs
+// over and over, so instances are reset and handed out again instead.
+// Thread-safe: each lease is exclusive to its holder.
+class ResamplerCache
+{
+  public:
+    using Resampler = aaudio::resampler::MultiChannelResampler;
+    using Quality = Resampler::Quality;
+
+    // Exclusive handle to a reset resampler; returns it to the cache when
+    // destroyed
+    class Lease
+    {
+      public:
+        Lease(Lease &&other) noexcept = default;
+        Lease &operator=(Lease &&other) = delete;
+        ~Lease();
+
+        Resampler *operator->() const { return resampler_.get(); }
+        Resampler &operator*() const { return *resampler_; }
+
+      private:
+        friend class ResamplerCache;
+        using Key = std::tuple<int, int, Quality, int>;
+
+        Lease(ResamplerCache &cache, Key key,
+              std::unique_ptr<Resampler> resampler)
+            : cache_(&cache), key_(key), resampler_(std::move(resampler))
+        {
+        }
+
+        ResamplerCache *cache_;
+        Key key_;
+        std::unique_ptr<Resampler> resampler_;
+    };
+
+    struct Stats
+    {
+        int created = 0;
+        int reused = 0;
+    };
+
+    static ResamplerCache &instance();
+
+    Lease acquire(int channels, int input_rate, int output_rate,
+                  Quality quality);
+
+    Stats stats() const;
+
+  private:
+    void release(const Lease::Key &key, std::unique_ptr<Resampler> resampler);
+
+    mutable std::mutex mutex_;
+    std::map<Lease::Key, std::vector<std::unique_ptr<Resampler>>> idle_;
+    Stats stats_;
+};
+} // namespace basic_pitch
+
+#endif // BASIC_PITCH_RESAMPLER_CACHE_HPP
@@ -3,9 +3,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <emscripten.h>
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <emscripten/threading.h>
+#endif
 #include <iostream>
-#include <libremidi/libremidi.hpp>
-#include <libremidi/writer.hpp>
+#include <malloc.h>
 #include <map>
 #include <numeric>
 #include <ranges>
@@ -14,6 +16,39 @@
 #include <vector>
 
 #include "basicpitch.hpp"
+#include "engine.hpp"
+#include "workspace.hpp"
+#include <memory>
+
+#ifndef BASIC_PITCH_NO_EMBEDDED_MODEL
+#include "model.ort.h"
+#endif
+
+// Session and scratch buffers stay resident between transcriptions, so only
+// the first one in a page pays for model initialization
+static std::unique_ptr<basic_pitch::Engine> g_engine;
+static std::unique_ptr<basic_pitch::Workspace> g_workspace;
+
+// Posteriorgrams of the last inference, kept so only post-processing reruns
+// when parameters change
+static std::unique_ptr<basic_pitch::InferenceResult> g_result;
+
+static basic_pitch::BasicPitchConfig
+make_config(float onset_threshold, float frame_threshold, float min_frequency,
+            float max_frequency, float min_note_length, float tempo_bpm,
+            int use_melodia_trick, int include_pitch_bends)
+{
+    basic_pitch::BasicPitchConfig config;
+    config.onset_threshold = onset_threshold;
+    config.frame_threshold = frame_threshold;
+    config.min_frequency = min_frequency;
+    config.max_frequency = max_frequency;
+    config.min_note_length = min_note_length;
+    config.tempo_bpm = tempo_bpm;
+    config.use_melodia_trick = (use_melodia_trick != 0);
+    config.include_pitch_bends = (include_pitch_bends != 0);
+    return config;
+}
 
 extern "C"
 {
@@ -22,27 +57,180 @@ extern "C"
     EM_JS(void, callWriteWasmLog, (const char *str),
           {console.log(UTF8ToString(str))});
 
+    // Reports inference progress to the module's onInferenceProgress hook
+    // (set by the worker), if any
+    EM_JS(void, callReportProgress, (int chunks_done, int n_chunks), {
+        if (Module['onInferenceProgress'])
+        {
+            Module['onInferenceProgress'](chunks_done, n_chunks);
+        }
+    });
+
+    // 1 if the model is compiled into this module, 0 if it was built with
+    // BASICPITCH_EMBED_MODEL=OFF and needs bp_init_with_model
     EMSCRIPTEN_KEEPALIVE
-    void convertToMidi(const float *mono_audio, int length,
-                       uint8_t **midi_data_ptr, int *midi_size,
-                       float onset_threshold, float frame_threshold,
-                       float min_frequency, float max_frequency, 
-                       float min_note_length, float tempo_bpm,
-                       int use_melodia_trick, int include_pitch_bends)
+    int bp_has_embedded_model()
     {
-        callWriteWasmLog("Starting inference...");
-
-        // Create configuration object with provided parameters
-        basic_pitch::BasicPitchConfig config;
-        config.onset_threshold = onset_threshold;
-        config.frame_threshold = frame_threshold;
-        config.min_frequency = min_frequency;
-        config.max_frequency = max_frequency;
-        config.min_note_length = min_note_length;
-        config.tempo_bpm = tempo_bpm;
-        config.use_melodia_trick = (use_melodia_trick != 0);
-        config.include_pitch_bends = (include_pitch_bends != 0);
-        
+#ifdef BASIC_PITCH_NO_EMBEDDED_MODEL
+        return 0;
+#else
+        return 1;
+#endif
+    }
+
+    // Creates the ORT session from the ORT-format model in model_data (e.g.
+    // fetched from Cache Storage) and the workspace; ORT copies the model,
+    // so the caller may free the buffer afterwards. A no-op if a model is
+    // already loaded. Returns 1 once the model is ready.
+    EMSCRIPTEN_KEEPALIVE
+    int bp_init_with_model(const uint8_t *model_data, int model_size)
+    {
+        if (g_engine)
+        {
+            return 1;
+        }
+        if (model_data == nullptr || model_size <= 0)
+        {
+            callWriteWasmLog("No model data.");
+            return 0;
+        }
+
+        callWriteWasmLog("Initializing model...");
+
+        int intra_op_threads = 0;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        // one intra-op thread per core from the pthread pool
+        intra_op_threads = emscripten_num_logical_cores();
+#endif
+        g_engine = std::make_unique<basic_pitch::Engine>(
+            model_data, model_size, intra_op_threads);
+        g_workspace = std::make_unique<basic_pitch::Workspace>();
+
+        callWriteWasmLog("Model initialized.");
+        return 1;
+    }
+
+    // Creates the ORT session from the embedded model and the workspace;
+    // calling it again, or after bp_init_with_model, is a no-op. Returns 1
+    // once the model is ready, 0 if the module has no embedded model and
+    // bp_init_with_model has not been called.
+    EMSCRIPTEN_KEEPALIVE
+    int bp_init()
+    {
+        if (g_engine)
+        {
+            return 1;
+        }
+#ifdef BASIC_PITCH_NO_EMBEDDED_MODEL
+        callWriteWasmLog("No embedded model, call bp_init_with_model first.");
+        return 0;
+#else
+        return bp_init_with_model(model_ort_start, model_ort_size);
+#endif
+    }
+
+    // Runs the model on mono 22050 Hz audio with the resident session,
+    // batch_chunks windows at a time (0: all at once), reporting progress
+    // after each batch. Peak memory then depends on the batch size rather
+    // than the audio length, apart from the audio and the posteriorgrams.
+    // The posteriorgrams stay resident for bp_notes_to_midi and
+    // bp_posteriorgram until the next inference or bp_release_result.
+    // Returns the number of frames.
+    EMSCRIPTEN_KEEPALIVE
+    int bp_infer(const float *mono_audio, int length, int batch_chunks)
+    {
+        if (!bp_init())
+        {
+            return 0;
+        }
+
+        // drop the previous file's posteriorgrams before growing new ones
+        g_result.reset();
+        g_result = std::make_unique<basic_pitch::InferenceResult>(
+            basic_pitch::ort_inference_in_batches(
+                g_engine->session(), mono_audio, length, batch_chunks,
+                callReportProgress, g_workspace.get()));
+
+        callWriteWasmLog("Inference finished.");
+        return g_result->notes.dimension(0);
+    }
+
+    // Worker pool support: runs the model on chunks [first_chunk,
+    // first_chunk + n_chunks) of a file of total_length samples, given its
+    // samples [audio_offset, audio_offset + length) (see
+    // basic_pitch::ort_chunk_samples), and keeps the frames of those chunks
+    // resident for bp_posteriorgram. *first_frame is set to the frame of the
+    // whole file they start at. Returns the number of frames.
+    EMSCRIPTEN_KEEPALIVE
+    int bp_infer_range(const float *audio, int length, int audio_offset,
+                       int total_length, int first_chunk, int n_chunks,
+                       int batch_chunks, int *first_frame)
+    {
+        *first_frame = basic_pitch::ort_chunk_first_frame(first_chunk);
+        if (!bp_init())
+        {
+            return 0;
+        }
+
+        g_result.reset();
+        g_result = std::make_unique<basic_pitch::InferenceResult>(
+            basic_pitch::ort_inference_chunk_range(
+                g_engine->session(), audio, length, audio_offset,
+                total_length, first_chunk, n_chunks, batch_chunks,
+                callReportProgress, g_workspace.get()));
+        return g_result->notes.dimension(0);
+    }
+
+    // Worker pool support: sizes resident posteriorgram which (0 notes,
+    // 1 onsets, 2 contours) to n_frames x n_bins and returns it for the
+    // caller to fill, column-major as in bp_posteriorgram, with the ranges
+    // stitched together; bp_notes_to_midi then post-processes the whole
+    // file. Returns nullptr on a bad index.
+    EMSCRIPTEN_KEEPALIVE
+    float *bp_import_posteriorgram(int which, int n_frames, int n_bins)
+    {
+        if (which < 0 || which > 2 || n_frames < 0 || n_bins < 0 ||
+            !bp_init())
+        {
+            return nullptr;
+        }
+        if (!g_result)
+        {
+            g_result = std::make_unique<basic_pitch::InferenceResult>();
+        }
+        Eigen::Tensor2dXf &posteriorgram =
+            which == 0 ? g_result->notes
+                       : (which == 1 ? g_result->onsets : g_result->contours);
+        posteriorgram.resize(n_frames, n_bins);
+        return posteriorgram.data();
+    }
+
+    // Post-processes the resident posteriorgrams into a MIDI file; no model
+    // run, so parameter changes re-render quickly. On success
+    // *midi_data_ptr points at module-owned MIDI bytes that stay valid
+    // until the next call producing MIDI or bp_shutdown; the caller copies
+    // them out and must not free them. Returns the MIDI size, or 0 if there
+    // is no resident inference result.
+    EMSCRIPTEN_KEEPALIVE
+    int bp_notes_to_midi(uint8_t **midi_data_ptr, int *midi_size,
+                         float onset_threshold, float frame_threshold,
+                         float min_frequency, float max_frequency,
+                         float min_note_length, float tempo_bpm,
+                         int use_melodia_trick, int include_pitch_bends)
+    {
+        *midi_data_ptr = nullptr;
+        *midi_size = 0;
+        if (!g_result || !g_workspace)
+        {
+            callWriteWasmLog("No inference result to convert.");
+            return 0;
+        }
+
+        basic_pitch::BasicPitchConfig config = make_config(
+            onset_threshold, frame_threshold, min_frequency, max_frequency,
+            min_note_length, tempo_bpm, use_melodia_trick,
+            include_pitch_bends);
+
         // Log the configuration being used
         std::ostringstream config_log;
         config_log << "Configuration: onset=" << config.onset_threshold 
@@ -53,23 +241,130 @@ extern "C"
                    << " bends=" << (config.include_pitch_bends ? "on" : "off");
         callWriteWasmLog(config_log.str().c_str());
 
-        auto inference_result = basic_pitch::ort_inference(mono_audio, length);
-
-        callWriteWasmLog("Inference finished. Now generating MIDI file...");
-
-        // Call the function to convert the output to MIDI with configuration
-        std::vector<uint8_t> midiBytes =
-            basic_pitch::convert_to_midi(inference_result, config);
-
-        callWriteWasmLog("MIDI file generated. Now saving to blob...");
+        basic_pitch::Workspace &ws = *g_workspace;
+        std::vector<uint8_t> &midiBytes = ws.output;
+        std::size_t output_capacity = ws.begin_append(midiBytes);
+        basic_pitch::convert_to_midi(*g_result, config, midiBytes, nullptr,
+                                     &ws);
+        ws.used(midiBytes, output_capacity);
+        ws.end_job();
 
         // Log the size of the MIDI data
         std::ostringstream log_message;
         log_message << "MIDI data size: " << midiBytes.size();
         callWriteWasmLog(log_message.str().c_str());
 
-        // Allocate memory in WASM for the MIDI data and copy the contents
+        *midi_data_ptr = midiBytes.data();
         *midi_size = midiBytes.size();
+        return *midi_size;
+    }
+
+    // One resident posteriorgram for zero-copy HEAPF32 views: 0 notes,
+    // 1 onsets, 2 contours. Column-major, so (frame t, bin f) is element
+    // f * n_frames + t. Returns nullptr if there is no resident result; the
+    // pointer is invalidated by the next inference, bp_release_result and
+    // by heap growth (re-create the view after any call that allocates).
+    EMSCRIPTEN_KEEPALIVE
+    const float *bp_posteriorgram(int which, int *n_frames, int *n_bins)
+    {
+        *n_frames = 0;
+        *n_bins = 0;
+        if (!g_result || which < 0 || which > 2)
+        {
+            return nullptr;
+        }
+        const Eigen::Tensor2dXf &posteriorgram =
+            which == 0 ? g_result->notes
+                       : (which == 1 ? g_result->onsets : g_result->contours);
+        *n_frames = posteriorgram.dimension(0);
+        *n_bins = posteriorgram.dimension(1);
+        return posteriorgram.data();
+    }
+
+    // Frees the resident posteriorgrams
+    EMSCRIPTEN_KEEPALIVE
+    void bp_release_result()
+    {
+        g_result.reset();
+    }
+
+    // Allocator statistics for benchmarks: bytes currently allocated with
+    // malloc/new, and the most the allocator has taken from the heap so
+    // far. The wasm memory itself (HEAPU8.length) only grows, so it is its
+    // own high-water mark.
+    EMSCRIPTEN_KEEPALIVE
+    void bp_heap_stats(double *in_use_bytes, double *peak_footprint_bytes)
+    {
+        struct mallinfo info = mallinfo();
+        *in_use_bytes = static_cast<double>(info.uordblks);
+        *peak_footprint_bytes = static_cast<double>(info.usmblks);
+    }
+
+    // bp_infer followed by bp_notes_to_midi; see there for the lifetime of
+    // the returned MIDI data and the posteriorgrams
+    EMSCRIPTEN_KEEPALIVE
+    int bp_transcribe_batched(const float *mono_audio, int length,
+                              int batch_chunks, uint8_t **midi_data_ptr,
+                              int *midi_size, float onset_threshold,
+                              float frame_threshold, float min_frequency,
+                              float max_frequency, float min_note_length,
+                              float tempo_bpm, int use_melodia_trick,
+                              int include_pitch_bends)
+    {
+        *midi_data_ptr = nullptr;
+        *midi_size = 0;
+        bp_infer(mono_audio, length, batch_chunks);
+        return bp_notes_to_midi(midi_data_ptr, midi_size, onset_threshold,
+                                frame_threshold, min_frequency, max_frequency,
+                                min_note_length, tempo_bpm, use_melodia_trick,
+                                include_pitch_bends);
+    }
+
+    // bp_transcribe_batched with every window in a single batch
+    EMSCRIPTEN_KEEPALIVE
+    int bp_transcribe(const float *mono_audio, int length,
+                      uint8_t **midi_data_ptr, int *midi_size,
+                      float onset_threshold, float frame_threshold,
+                      float min_frequency, float max_frequency,
+                      float min_note_length, float tempo_bpm,
+                      int use_melodia_trick, int include_pitch_bends)
+    {
+        return bp_transcribe_batched(
+            mono_audio, length, 0, midi_data_ptr, midi_size, onset_threshold,
+            frame_threshold, min_frequency, max_frequency, min_note_length,
+            tempo_bpm, use_melodia_trick, include_pitch_bends);
+    }
+
+    // Frees the session and every resident buffer; bp_init (or the next
+    // transcription) loads the model again
+    EMSCRIPTEN_KEEPALIVE
+    void bp_shutdown()
+    {
+        g_result.reset();
+        g_workspace.reset();
+        g_engine.reset();
+        callWriteWasmLog("Model released.");
+    }
+
+    // One-shot variant kept for existing callers: same as bp_transcribe, but
+    // the MIDI data is copied into a malloc'd buffer the caller frees
+    EMSCRIPTEN_KEEPALIVE
+    void convertToMidi(const float *mono_audio, int length,
+                       uint8_t **midi_data_ptr, int *midi_size,
+                       float onset_threshold, float frame_threshold,
+                       float min_frequency, float max_frequency, 
+                       float min_note_length, float tempo_bpm,
+                       int use_melodia_trick, int include_pitch_bends)
+    {
+        uint8_t *resident_data = nullptr;
+        int resident_size = 0;
+        bp_transcribe(mono_audio, length, &resident_data, &resident_size,
+                      onset_threshold, frame_threshold, min_frequency,
+                      max_frequency, min_note_length, tempo_bpm,
+                      use_melodia_trick, include_pitch_bends);
+
+        // Allocate memory in WASM for the MIDI data and copy the contents
+        *midi_size = resident_size;
         *midi_data_ptr = (uint8_t *)malloc(*midi_size);
         if (*midi_data_ptr == nullptr)
         {
@@ -82,7 +377,7 @@ extern "C"
         }
 
         // Copy the MIDI data into the allocated memory
-        memcpy(*midi_data_ptr, midiBytes.data(), *midi_size);
+        memcpy(*midi_data_ptr, resident_data, *midi_size);
         
         callWriteWasmLog("MIDI data copied to WASM memory successfully.");
     }
@@ -0,0 +1,153 @@
+#include "midi_golden_cases.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <libremidi/libremidi.hpp>
+#include <libremidi/writer.hpp>
+#include <string>
+#include <vector>
+
+// Writes tests/data/<name>.mid for every case of midi_golden_cases.hpp with
+// the libremidi writer, through the event construction note_events_to_midi
+// used before it encoded MIDI itself. Only built when
+// BASICPITCH_LIBREMIDI_DIR points at a libremidi checkout.
+
+using namespace basic_pitch::constants;
+
+static uint32_t time_to_ticks(float time_seconds, int tempo_us,
+                              int tpqn = DEFAULT_TPQN)
+{
+    return static_cast<uint32_t>(
+        std::round((time_seconds * tpqn * 1'000'000) / tempo_us));
+}
+
+static libremidi::writer
+note_events_to_midi(const basic_pitch::NoteEventTable &note_events,
+                    int n_times_onsets)
+{
+    libremidi::writer midi_writer;
+    midi_writer.ticksPerQuarterNote = DEFAULT_TPQN;
+
+    // Track with tempo and time signature
+    libremidi::midi_track meta_track;
+    meta_track.emplace_back(0, 0, libremidi::meta_events::tempo(MIDI_TEMPO_US));
+    meta_track.emplace_back(
+        0, 0,
+        libremidi::meta_events::time_signature(TIME_SIGNATURE_NUMERATOR,
+                                               TIME_SIGNATURE_DENOMINATOR));
+    midi_writer.tracks.push_back(meta_track);
+
+    std::vector<float> frame_times =
+        basic_pitch::model_frames_to_time(n_times_onsets);
+
+    struct MidiEvent
+    {
+        uint32_t tick; // Absolute tick time
+        libremidi::message message;
+    };
+    std::vector<MidiEvent> midi_events;
+
+    for (std::size_t n = 0; n < note_events.size(); ++n)
+    {
+        float start_time = frame_times[note_events.start_idx[n]];
+        float end_time = frame_times[note_events.end_idx[n]];
+        int pitch = note_events.pitch[n];
+        uint32_t start_tick = time_to_ticks(start_time, MIDI_TEMPO_US);
+        uint32_t end_tick = time_to_ticks(end_time, MIDI_TEMPO_US);
+        int velocity = static_cast<int>(note_events.amplitude[n] * 127);
+
+        midi_events.push_back({start_tick, libremidi::channel_events::note_on(
+                                               0, pitch, velocity)});
+
+        if (note_events.has_bends(n))
+        {
+            const int8_t *pitch_bend = note_events.bends_of(n);
+            int num_bends = note_events.bend_length[n];
+
+            if (num_bends > 1)
+            {
+                float time_increment =
+                    (end_time - start_time) / (num_bends - 1);
+
+                for (int i = 0; i < num_bends; ++i)
+                {
+                    float bend_time = start_time + i * time_increment;
+                    uint32_t bend_tick =
+                        time_to_ticks(bend_time, MIDI_TEMPO_US);
+                    bend_tick = std::min(bend_tick, end_tick);
+
+                    int bend_value =
+                        pitch_bend[i] * (4096 / CONTOURS_BINS_PER_SEMITONE) +
+                        8192;
+                    bend_value = std::clamp(bend_value, 0, 16383);
+                    midi_events.push_back(
+                        {bend_tick,
+                         libremidi::channel_events::pitch_bend(0, bend_value)});
+                }
+            }
+            else
+            {
+                int bend_value =
+                    pitch_bend[0] * (4096 / CONTOURS_BINS_PER_SEMITONE) + 8192;
+                bend_value = std::clamp(bend_value, 0, 16383);
+                midi_events.push_back(
+                    {start_tick,
+                     libremidi::channel_events::pitch_bend(0, bend_value)});
+            }
+        }
+
+        midi_events.push_back(
+            {end_tick, libremidi::channel_events::note_off(0, pitch, 0)});
+    }
+
+    std::sort(midi_events.begin(), midi_events.end(),
+              [](const MidiEvent &a, const MidiEvent &b)
+              {
+                  if (a.tick != b.tick)
+                  {
+                      return a.tick < b.tick;
+                  }
+                  return a.message.get_message_type() <
+                         b.message.get_message_type();
+              });
+
+    libremidi::midi_track instrument_track;
+    instrument_track.emplace_back(0, 0,
+                                  libremidi::channel_events::program_change(
+                                      0, 4)); // Set program to Electric Piano
+
+    uint32_t last_tick = 0;
+    for (const auto &event : midi_events)
+    {
+        instrument_track.emplace_back(event.tick - last_tick, 0,
+                                      event.message);
+        last_tick = event.tick;
+    }
+
+    midi_writer.tracks.push_back(instrument_track);
+    return midi_writer;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output_dir>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (const MidiGoldenCase &test_case : midi_golden_cases())
+    {
+        std::string path = std::string(argv[1]) + "/" + test_case.name + ".mid";
+        std::ofstream out(path, std::ios::binary);
+        note_events_to_midi(test_case.notes, test_case.n_frames).write(out);
+        if (!out)
+        {
+            std::cerr << "Failed to write " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Wrote " << path << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
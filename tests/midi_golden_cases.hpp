@@ -0,0 +1,67 @@
+#ifndef BASIC_PITCH_MIDI_GOLDEN_CASES_HPP
+#define BASIC_PITCH_MIDI_GOLDEN_CASES_HPP
+
+#include "basicpitch.hpp"
+#include <string>
+#include <vector>
+
+// Note tables encoded by both test_midi_golden (built-in encoder) and
+// make_midi_goldens (libremidi), whose outputs are tests/data/<name>.mid
+
+struct MidiGoldenCase
+{
+    std::string name;
+    int n_frames; // model frames, for the frame to time mapping
+    basic_pitch::NoteEventTable notes;
+};
+
+inline void add_golden_note(basic_pitch::NoteEventTable &notes, int start,
+                            int end, int pitch, float amplitude,
+                            const std::vector<int8_t> &bends = {})
+{
+    notes.push_back(start, end, pitch, amplitude);
+    notes.bend_offset.back() = notes.bends.size();
+    notes.bend_length.back() = bends.size();
+    notes.bends.insert(notes.bends.end(), bends.begin(), bends.end());
+}
+
+inline std::vector<MidiGoldenCase> midi_golden_cases()
+{
+    std::vector<MidiGoldenCase> cases;
+
+    // no notes: only the tempo track and the program change
+    cases.push_back({"empty", 100, {}});
+
+    // overlapping notes, and a note off and note on on the same tick
+    MidiGoldenCase chords{"chords", 400, {}};
+    add_golden_note(chords.notes, 10, 60, 60, 0.8f);
+    add_golden_note(chords.notes, 10, 60, 64, 0.6f);
+    add_golden_note(chords.notes, 10, 90, 67, 0.5f);
+    add_golden_note(chords.notes, 60, 120, 62, 1.0f);
+    add_golden_note(chords.notes, 200, 211, 21, 0.3f);
+    add_golden_note(chords.notes, 300, 399, 108, 0.05f);
+    cases.push_back(std::move(chords));
+
+    // pitch bends: a single bend, ramps, values clamped at both ends, and
+    // more bends than the note has ticks
+    MidiGoldenCase bends{"bends", 300, {}};
+    add_golden_note(bends.notes, 5, 30, 57, 0.7f, {1});
+    add_golden_note(bends.notes, 20, 45, 69, 0.9f,
+                    {-3, -2, -1, 0, 1, 2, 3, 2, 1, 0, 0, 0, -1});
+    add_golden_note(bends.notes, 50, 52, 72, 0.4f, {0, 4, -4, 4, -4, 0});
+    add_golden_note(bends.notes, 100, 180, 48, 0.6f,
+                    {-127, -100, -13, 13, 100, 127});
+    add_golden_note(bends.notes, 150, 160, 76, 0.2f);
+    cases.push_back(std::move(bends));
+
+    // deltas needing three- and four-byte variable length quantities
+    MidiGoldenCase long_file{"long", 450000, {}};
+    add_golden_note(long_file.notes, 0, 20, 60, 0.5f);
+    add_golden_note(long_file.notes, 9000, 9100, 62, 0.5f, {0, 1, 2});
+    add_golden_note(long_file.notes, 440000, 440990, 64, 0.5f);
+    cases.push_back(std::move(long_file));
+
+    return cases;
+}
+
+#endif // BASIC_PITCH_MIDI_GOLDEN_CASES_HPP
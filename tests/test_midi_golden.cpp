@@ -0,0 +1,74 @@
+#include "kernels.hpp"
+#include "midi_golden_cases.hpp"
+#include "workspace.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// The built-in MIDI encoder has to produce the same bytes as the libremidi
+// writer it replaced. Every case of midi_golden_cases.hpp is encoded and
+// compared with tests/data/<name>.mid, written by make_midi_goldens.
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <golden_dir>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string golden_dir = argv[1];
+
+    const basic_pitch::BasicPitchConfig config;
+    int failures = 0;
+    for (const MidiGoldenCase &test_case : midi_golden_cases())
+    {
+        std::string path = golden_dir + "/" + test_case.name + ".mid";
+        std::vector<uint8_t> expected = read_file(path);
+        if (expected.empty())
+        {
+            std::cerr << test_case.name << ": cannot read " << path
+                      << std::endl;
+            ++failures;
+            continue;
+        }
+
+        basic_pitch::Workspace workspace;
+        std::vector<uint8_t> midi_data;
+        basic_pitch::kernels::note_events_to_midi(
+            test_case.notes, test_case.n_frames, config, midi_data, nullptr,
+            workspace);
+
+        if (midi_data != expected)
+        {
+            std::size_t offset = 0;
+            while (offset < midi_data.size() && offset < expected.size() &&
+                   midi_data[offset] == expected[offset])
+            {
+                ++offset;
+            }
+            std::cerr << test_case.name << ": " << midi_data.size()
+                      << " bytes, golden " << expected.size()
+                      << " bytes, first difference at byte " << offset
+                      << std::endl;
+            ++failures;
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " golden file(s) differ" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "MIDI encoder: all golden files match" << std::endl;
+    return EXIT_SUCCESS;
+}
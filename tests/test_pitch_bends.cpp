@@ -0,0 +1,102 @@
+#include "kernels.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Pitch bend simplification: a MIDI bend holds its value until the next
+// one, so after simplifying, the value held at every original point must
+// stay within the tolerance of that point.
+
+using basic_pitch::kernels::BendPoint;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do                                                                       \
+    {                                                                        \
+        if (!(cond))                                                         \
+        {                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond     \
+                      << ") failed" << std::endl;                            \
+            ++failures;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Largest distance between each original point and the value the simplified
+// curve holds at its tick
+static int max_held_error(const std::vector<BendPoint> &original,
+                          const std::vector<BendPoint> &simplified)
+{
+    int max_error = 0;
+    std::size_t k = 0;
+    for (const BendPoint &point : original)
+    {
+        while (k + 1 < simplified.size() &&
+               simplified[k + 1].tick <= point.tick)
+        {
+            ++k;
+        }
+        max_error =
+            std::max(max_error, std::abs(point.value - simplified[k].value));
+    }
+    return max_error;
+}
+
+static std::vector<BendPoint> ramp(int first_value, int step, int n_points)
+{
+    std::vector<BendPoint> points;
+    for (int i = 0; i < n_points; ++i)
+    {
+        points.push_back(
+            {static_cast<uint32_t>(10 * i), first_value + i * step});
+    }
+    return points;
+}
+
+static void check_held_curve(const std::vector<BendPoint> &original,
+                             float tolerance)
+{
+    std::vector<BendPoint> simplified = original;
+    basic_pitch::kernels::simplify_pitch_bends(simplified, tolerance);
+    CHECK(!simplified.empty());
+    CHECK(simplified.front().tick == original.front().tick);
+    CHECK(max_held_error(original, simplified) <= tolerance);
+}
+
+int main()
+{
+    // contour bins -1, 0, 1: every point is further than 1 unit from the
+    // value held before it, so nothing may be dropped
+    std::vector<BendPoint> points = ramp(6827, 1365, 3);
+    basic_pitch::kernels::simplify_pitch_bends(points, 1.0f);
+    CHECK(points.size() == 3);
+    check_held_curve(ramp(6827, 1365, 3), 1.0f);
+
+    // slow ramps up and down, at tolerances below and above the step
+    for (float tolerance : {0.0f, 1.0f, 100.0f, 512.0f, 2048.0f})
+    {
+        check_held_curve(ramp(8192, 37, 200), tolerance);
+        check_held_curve(ramp(8192, -37, 200), tolerance);
+        check_held_curve(ramp(4096, 1365, 7), tolerance);
+    }
+
+    // a shallow ramp is thinned to one point per tolerance band
+    points = ramp(8192, 10, 101);
+    basic_pitch::kernels::simplify_pitch_bends(points, 100.0f);
+    CHECK(points.size() == 10);
+
+    // zero tolerance only drops repeats of the held value
+    points = {{0, 8192}, {10, 8192}, {20, 8300}, {30, 8300}, {40, 8192}};
+    basic_pitch::kernels::simplify_pitch_bends(points, 0.0f);
+    CHECK(points.size() == 3);
+    CHECK(points[1].tick == 20 && points[2].tick == 40);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "pitch bend simplification: all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
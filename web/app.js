@@ -12,9 +12,14 @@ function initializeParameterControls() {
         if (slider && valueSpan) {
             slider.addEventListener('input', function() {
                 valueSpan.textContent = this.value;
+                requestRerender();
             });
         }
     });
+
+    ['useMelodiaTrick', 'includePitchBends'].forEach(checkboxId => {
+        document.getElementById(checkboxId)?.addEventListener('change', requestRerender);
+    });
 }
 
 document.addEventListener('DOMContentLoaded', initializeParameterControls);
@@ -36,6 +41,10 @@ function getAudioContext() {
     return audioContext;
 }
 
+// The SIMD + threads build has not been verified in a browser yet, so the
+// worker only tries it when the page is opened with ?simd-mt
+const USE_SIMD_THREADS = new URLSearchParams(location.search).has('simd-mt');
+
 const worker = new Worker('worker.js');
 
 const fileInput = document.getElementById('fileInput');
@@ -81,8 +90,224 @@ function showFileInfo(file) {
 let wasmReady = false;
 let pendingAudio = null;
 
+// Audio of the last transcribed file, and whether the worker holds its
+// posteriorgrams so parameter changes only re-run post-processing
+let lastMonoAudio = null;
+let hasResult = false;
+let rerenderInFlight = false;
+let rerenderPending = false;
+let midiBlobUrl = null;
+
+function readConfig() {
+    return {
+        onset_threshold: parseFloat(document.getElementById('onsetThreshold')?.value || '0.5'),
+        frame_threshold: parseFloat(document.getElementById('frameThreshold')?.value || '0.3'),
+        min_frequency: parseFloat(document.getElementById('minFrequency')?.value || '27.5'),
+        max_frequency: parseFloat(document.getElementById('maxFrequency')?.value || '4186.0'),
+        min_note_length: parseFloat(document.getElementById('minNoteLength')?.value || '0.127'),
+        tempo_bpm: parseFloat(document.getElementById('tempoBpm')?.value || '120.0'),
+        use_melodia_trick: document.getElementById('useMelodiaTrick')?.checked ?? true,
+        include_pitch_bends: document.getElementById('includePitchBends')?.checked ?? true
+    };
+}
+
+// Called on every control change; keeps at most one re-render in flight and
+// coalesces the changes made meanwhile into one more
+function requestRerender() {
+    if (!hasResult) {
+        return;
+    }
+    if (rerenderInFlight) {
+        rerenderPending = true;
+        return;
+    }
+    rerenderInFlight = true;
+    rerenderPending = false;
+    worker.postMessage({ msg: 'RERENDER', config: readConfig() });
+}
+
+function rerenderDone() {
+    rerenderInFlight = false;
+    if (rerenderPending) {
+        requestRerender();
+    }
+}
+
+// Worker pool: without cross-origin isolation there are no wasm threads, so
+// a long file is split into ranges of model windows that several workers,
+// each with its own module, transcribe in parallel. The main worker then
+// stitches their posteriorgrams and post-processes the whole file once, so
+// re-renders work as usual.
+const POOL_SIZE = Math.min(navigator.hardwareConcurrency || 1, 4);
+// Fewer windows per worker do not pay for loading another module
+const MIN_CHUNKS_PER_WORKER = 4;
+
+// The model windows as cut by src/ort_inference.cpp: 2 s minus one hop of
+// audio each, overlapping by 30 frames, after padding the start by half the
+// overlap
+const CHUNK_SAMPLES = 2 * SAMPLE_RATE - 256;
+const CHUNK_OVERLAP = 30 * 256;
+const CHUNK_HOP = CHUNK_SAMPLES - CHUNK_OVERLAP;
+
+function numChunks(length) {
+    return Math.ceil((CHUNK_OVERLAP / 2 + length) / CHUNK_HOP);
+}
+
+// Samples [begin, end) read by windows [firstChunk, firstChunk + nChunks),
+// as basic_pitch::ort_chunk_samples
+function chunkSamples(totalLength, firstChunk, nChunks) {
+    const clamp = (x, lo, hi) => Math.min(Math.max(x, lo), hi);
+    const begin = clamp(firstChunk * CHUNK_HOP - CHUNK_OVERLAP / 2, 0, totalLength);
+    const end = clamp((firstChunk + nChunks - 1) * CHUNK_HOP - CHUNK_OVERLAP / 2 + CHUNK_SAMPLES,
+                      begin, totalLength);
+    return [begin, end];
+}
+
+const helperWorkers = []; // pool workers besides `worker`, created on first use
+let poolUnsupported = false; // module without bp_infer_range, or a helper failed
+let poolJob = null;
+let nextJobId = 1;
+
+function poolWorkerCount(length) {
+    if (poolUnsupported || self.crossOriginIsolated || POOL_SIZE < 2) {
+        return 1;
+    }
+    return Math.max(1, Math.min(POOL_SIZE, Math.floor(numChunks(length) / MIN_CHUNKS_PER_WORKER)));
+}
+
+function startPoolJob(monoAudio, config, nWorkers) {
+    while (helperWorkers.length < nWorkers - 1) {
+        const helper = new Worker('worker.js');
+        const index = helperWorkers.length + 1;
+        helper.ready = false;
+        helper.onmessage = e => onPoolMessage(index, e.data);
+        helper.onerror = e => {
+            console.error(`Pool worker ${index} failed:`, e.message);
+            onHelperFailed(index);
+        };
+        helper.postMessage({ msg: 'LOAD_WASM', scriptName: 'basicpitch.js', simdThreads: USE_SIMD_THREADS });
+        helperWorkers.push(helper);
+    }
+    poolJob = {
+        id: nextJobId++,
+        monoAudio,
+        config,
+        workers: [worker, ...helperWorkers.slice(0, nWorkers - 1)],
+        totalChunks: numChunks(monoAudio.length),
+        chunksDone: [],
+        parts: [],
+        pending: 0,
+        started: false
+    };
+    dispatchPoolJob();
+}
+
+// Sends every worker its range once all of them have loaded the module
+function dispatchPoolJob() {
+    const job = poolJob;
+    if (!job || job.started || !job.workers.every(w => w === worker || w.ready)) {
+        return;
+    }
+    job.started = true;
+
+    const totalLength = job.monoAudio.length;
+    const perWorker = Math.ceil(job.totalChunks / job.workers.length);
+    job.workers.forEach((w, i) => {
+        const firstChunk = i * perWorker;
+        const nChunks = Math.min(perWorker, job.totalChunks - firstChunk);
+        if (nChunks <= 0) {
+            return;
+        }
+        const [begin, end] = chunkSamples(totalLength, firstChunk, nChunks);
+        const audioData = job.monoAudio.slice(begin, end);
+        job.pending++;
+        w.postMessage({
+            msg: 'INFER_RANGE',
+            jobId: job.id,
+            audioData: audioData.buffer,
+            audioOffset: begin,
+            totalLength,
+            firstChunk,
+            nChunks
+        }, [audioData.buffer]);
+    });
+}
+
+// A helper that fails to load the module or to run its range takes the pool
+// out of use; the job it held runs on the main worker alone instead
+function onHelperFailed(index) {
+    const helper = helperWorkers[index - 1];
+    if (helper.failed) {
+        return;
+    }
+    helper.failed = true;
+    poolUnsupported = true;
+    const job = poolJob;
+    if (job && job.workers.includes(helper)) {
+        console.warn(`Pool worker ${index} failed, transcribing on one worker`);
+        poolJob = null;
+        sendToWorker(job.monoAudio, job.config);
+    }
+}
+
+// Handles a pool message from worker index (0 is the main worker); returns
+// false for messages the main worker's usual handler should see
+function onPoolMessage(index, data) {
+    if (index > 0 && data.msg === 'WASM_READY') {
+        helperWorkers[index - 1].ready = true;
+        dispatchPoolJob();
+        return true;
+    }
+    if (index > 0 && data.msg === 'PROCESSING_FAILED') {
+        // also arrives before WASM_READY, or with no job, if loading failed
+        onHelperFailed(index);
+        return true;
+    }
+    const job = poolJob;
+    if (!job) {
+        return index > 0;
+    }
+
+    if (data.msg === 'PROGRESS') {
+        job.chunksDone[index] = data.chunksDone;
+        const chunksDone = job.chunksDone.reduce((sum, n) => sum + (n || 0), 0);
+        const percent = Math.round(85 * chunksDone / job.totalChunks);
+        updateProgress(percent);
+        showStatus(`Transcribing on ${job.workers.length} workers... ${percent}%`, 'processing');
+        return true;
+    }
+    if (data.msg === 'RANGE_DONE') {
+        if (data.jobId !== job.id) {
+            return true; // from a file replaced meanwhile
+        }
+        job.parts.push(data);
+        if (--job.pending === 0) {
+            poolJob = null;
+            const transfers = job.parts.flatMap(part =>
+                [part.notes.buffer, part.onsets.buffer, part.contours.buffer]);
+            worker.postMessage({ msg: 'IMPORT_RESULT', parts: job.parts, config: job.config }, transfers);
+        }
+        return true;
+    }
+    if (data.msg === 'RANGE_UNSUPPORTED') {
+        // module built before bp_infer_range: transcribe on one worker
+        poolUnsupported = true;
+        poolJob = null;
+        sendToWorker(job.monoAudio, job.config);
+        return true;
+    }
+    if (data.msg === 'PROCESSING_FAILED') {
+        poolJob = null;
+        return false; // main worker: reported by the usual handler
+    }
+    return index > 0;
+}
+
 worker.onmessage = function(e) {
     const data = e.data;
+    if (onPoolMessage(0, data)) {
+        return;
+    }
     if (data.msg === 'WASM_READY') {
         wasmReady = true;
         if (pendingAudio) {
@@ -92,23 +317,59 @@ worker.onmessage = function(e) {
         return;
     }
 
+    if (data.msg === 'PROGRESS') {
+        // inference is the bulk of the work; leave the rest of the bar for
+        // MIDI generation
+        const percent = Math.round(85 * data.chunksDone / data.totalChunks);
+        updateProgress(percent);
+        showStatus(`Transcribing... ${percent}%`, 'processing');
+        return;
+    }
+
+    if (data.msg === 'RERENDER_UNSUPPORTED') {
+        // older module or nothing resident: run the whole transcription
+        hasResult = false;
+        rerenderInFlight = false;
+        rerenderPending = false;
+        if (lastMonoAudio) {
+            showStatus('Re-transcribing with new parameters...', 'processing');
+            showProgress();
+            sendToWorker(lastMonoAudio, readConfig());
+        }
+        return;
+    }
+
     if (data.msg === 'PROCESSING_DONE') {
-        updateProgress(90);
-        showStatus('Creating MIDI file...', 'info');
+        hasResult = true;
+        if (midiBlobUrl) {
+            URL.revokeObjectURL(midiBlobUrl);
+        }
         const midiBlob = data.blob;
-        const blobUrl = URL.createObjectURL(midiBlob);
+        midiBlobUrl = URL.createObjectURL(midiBlob);
+        const blobUrl = midiBlobUrl;
         downloadBtn.onclick = () => {
             const link = document.createElement('a');
             link.href = blobUrl;
             link.download = 'output.mid';
             link.click();
         };
+
+        if (data.rerender) {
+            showStatus(`MIDI updated in ${data.ms.toFixed(0)} ms`, 'success');
+            downloadBtn.style.display = 'inline-block';
+            rerenderDone();
+            return;
+        }
+
+        updateProgress(90);
+        showStatus('Creating MIDI file...', 'info');
         updateProgress(100);
         hideProgress();
         showStatus('MIDI file generated successfully!', 'success');
         downloadBtn.style.display = 'inline-block';
         console.log('MIDI processing complete');
     } else if (data.msg === 'PROCESSING_FAILED') {
+        rerenderDone();
         hideProgress();
         showStatus('WASM processing failed. Please try again.', 'error');
         console.error('WASM processing failed');
@@ -122,17 +383,10 @@ function processAudio(audioBuffer) {
     }
 
     const monoAudio = audioBuffer.getChannelData(0);
+    lastMonoAudio = monoAudio;
+    hasResult = false;
 
-    const config = {
-        onset_threshold: parseFloat(document.getElementById('onsetThreshold')?.value || '0.5'),
-        frame_threshold: parseFloat(document.getElementById('frameThreshold')?.value || '0.3'),
-        min_frequency: parseFloat(document.getElementById('minFrequency')?.value || '27.5'),
-        max_frequency: parseFloat(document.getElementById('maxFrequency')?.value || '4186.0'),
-        min_note_length: parseFloat(document.getElementById('minNoteLength')?.value || '0.127'),
-        tempo_bpm: parseFloat(document.getElementById('tempoBpm')?.value || '120.0'),
-        use_melodia_trick: document.getElementById('useMelodiaTrick')?.checked ?? true,
-        include_pitch_bends: document.getElementById('includePitchBends')?.checked ?? true
-    };
+    const config = readConfig();
 
     console.log('Processing with configuration:', config);
 
@@ -141,7 +395,7 @@ function processAudio(audioBuffer) {
 
     if (!wasmReady) {
         pendingAudio = { monoAudio, config };
-        worker.postMessage({ msg: 'LOAD_WASM', scriptName: 'basicpitch.js' });
+        worker.postMessage({ msg: 'LOAD_WASM', scriptName: 'basicpitch.js', simdThreads: USE_SIMD_THREADS });
         showStatus('Loading WASM module...', 'info');
         return;
     }
@@ -150,6 +404,11 @@ function processAudio(audioBuffer) {
 }
 
 function sendToWorker(monoAudio, config) {
+    const nWorkers = poolWorkerCount(monoAudio.length);
+    if (nWorkers > 1) {
+        startPoolJob(monoAudio, config, nWorkers);
+        return;
+    }
     worker.postMessage({
         msg: 'PROCESS_AUDIO',
         audioData: monoAudio,
@@ -1,8 +1,73 @@
 let loadedModule;
 
-onmessage = function(e) {
+// Model windows (about 1.7 s of audio each) per session.Run: bounds the
+// model's working memory regardless of file length and sets how often
+// progress is reported
+const BATCH_CHUNKS = 8;
+
+// Audio buffer in the WASM heap, kept across files and only regrown when a
+// longer file arrives
+let audioPointer = 0;
+let audioCapacityBytes = 0;
+
+// Pointers to the MIDI data pointer/size outputs, allocated once
+let midiDataPointer = 0;
+let midiSizePointer = 0;
+
+// Model for builds without an embedded one (BASICPITCH_EMBED_MODEL=OFF),
+// kept in Cache Storage apart from the wasm binary so either can change
+// without invalidating the other. Bump the cache name when model.ort changes.
+const MODEL_URL = 'model.ort';
+const MODEL_CACHE = 'basicpitch-model-v1';
+let modelReady = false;
+
+// Builds without the resident-session exports only have convertToMidi, which
+// returns a malloc'd copy of the MIDI data
+function hasResidentSession() {
+    return typeof loadedModule._bp_transcribe === 'function';
+}
+
+function ensureAudioBuffer(sizeBytes) {
+    // 16-byte aligned
+    const alignedSize = Math.ceil(sizeBytes / 16) * 16;
+    if (alignedSize > audioCapacityBytes) {
+        if (audioPointer) {
+            loadedModule._free(audioPointer);
+        }
+        audioPointer = loadedModule._malloc(alignedSize);
+        audioCapacityBytes = audioPointer ? alignedSize : 0;
+    }
+    return audioPointer;
+}
+
+function releaseBuffers() {
+    if (!loadedModule) {
+        return;
+    }
+    if (audioPointer) {
+        loadedModule._free(audioPointer);
+    }
+    if (midiDataPointer) {
+        loadedModule._free(midiDataPointer);
+    }
+    if (midiSizePointer) {
+        loadedModule._free(midiSizePointer);
+    }
+    audioPointer = midiDataPointer = midiSizePointer = 0;
+    audioCapacityBytes = 0;
+}
+
+onmessage = async function(e) {
     if (e.data.msg === 'LOAD_WASM') {
-        loadWASMModule(e.data.scriptName);
+        loadWASMModule(e.data.scriptName, e.data.simdThreads);
+    } else if (e.data.msg === 'SHUTDOWN') {
+        // Release the resident session and buffers, e.g. when the page is
+        // done transcribing; the next file initializes them again
+        releaseBuffers();
+        if (loadedModule && hasResidentSession()) {
+            loadedModule._bp_shutdown();
+        }
+        modelReady = false;
     } else if (e.data.msg === 'PROCESS_AUDIO') {
         if (!loadedModule) {
             console.error('WASM module not loaded yet');
@@ -25,89 +90,320 @@ onmessage = function(e) {
         console.log('Available module properties:', Object.keys(loadedModule));
         console.log('HEAPF32 available:', !!loadedModule.HEAPF32);
 
-        // Allocate memory for audio buffer (16-byte aligned)
-        const audioSizeBytes = inputData.length * 4;
-        const alignedSize = Math.ceil(audioSizeBytes / 16) * 16;
-        const audioPointer = loadedModule._malloc(alignedSize);
+        // Reuse the audio buffer from the previous file if it is big enough
+        ensureAudioBuffer(inputData.length * 4);
 
         const floatOffset = audioPointer >> 2;
-        if (floatOffset + inputData.length > loadedModule.HEAPF32.length) {
+        if (!audioPointer || floatOffset + inputData.length > loadedModule.HEAPF32.length) {
             console.error('Insufficient WASM memory for audio data');
             postMessage({ msg: 'PROCESSING_FAILED', error: 'Insufficient WASM memory' });
-            loadedModule._free(audioPointer);
             return;
         }
 
         // Copy audio data into WASM memory
         loadedModule.HEAPF32.set(inputData, floatOffset);
 
-        // Allocate memory for MIDI data pointer and size
-        const midiDataPointer = loadedModule._malloc(4);
-        const midiSizePointer = loadedModule._malloc(4);
-
-        // Extract configuration or use defaults
-        const config = e.data.config || {};
-        const onset_threshold = config.onset_threshold ?? 0.5;
-        const frame_threshold = config.frame_threshold ?? 0.3;
-        const min_frequency = config.min_frequency ?? 27.5;
-        const max_frequency = config.max_frequency ?? 4186.0;
-        const min_note_length = config.min_note_length ?? 0.127;
-        const tempo_bpm = config.tempo_bpm ?? 120.0;
-        const use_melodia_trick = config.use_melodia_trick ? 1 : 0;
-        const include_pitch_bends = config.include_pitch_bends ? 1 : 0;
+        ensureMidiPointers();
+
+        const configArgs = configToArgs(e.data.config);
+
+        if (!modelReady) {
+            // after SHUTDOWN; builds without an embedded model cannot
+            // reload it by themselves
+            try {
+                await initModel();
+            } catch (error) {
+                postMessage({ msg: 'PROCESSING_FAILED', error: error.message });
+                return;
+            }
+        }
 
         try {
-            loadedModule._convertToMidi(
-                audioPointer,
-                length,
-                midiDataPointer,
-                midiSizePointer,
-                onset_threshold,
-                frame_threshold,
-                min_frequency,
-                max_frequency,
-                min_note_length,
-                tempo_bpm,
-                use_melodia_trick,
-                include_pitch_bends
-            );
+            // The session is resident since load, so inference starts
+            // right away
+            if (typeof loadedModule._bp_transcribe_batched === 'function') {
+                loadedModule._bp_transcribe_batched(
+                    audioPointer, length, BATCH_CHUNKS,
+                    midiDataPointer, midiSizePointer, ...configArgs);
+            } else {
+                const transcribe = hasResidentSession()
+                    ? loadedModule._bp_transcribe
+                    : loadedModule._convertToMidi;
+                transcribe(audioPointer, length, midiDataPointer, midiSizePointer, ...configArgs);
+            }
         } catch (error) {
             console.error('Error during WASM inference:', error);
             postMessage({ msg: 'PROCESSING_FAILED', error: error.message });
-            loadedModule._free(audioPointer);
-            loadedModule._free(midiDataPointer);
-            loadedModule._free(midiSizePointer);
             return;
         }
 
-        // Retrieve MIDI data pointer and size
-        const midiData = loadedModule.getValue(midiDataPointer, 'i32');
-        const midiSize = loadedModule.getValue(midiSizePointer, 'i32');
+        postMidiResult({ ownedByModule: hasResidentSession() });
+    } else if (e.data.msg === 'INFER_RANGE') {
+        // Worker pool: run the model on one range of chunks and send the
+        // posteriorgram frames back for stitching
+        if (!loadedModule || typeof loadedModule._bp_infer_range !== 'function') {
+            postMessage({ msg: 'RANGE_UNSUPPORTED', jobId: e.data.jobId });
+            return;
+        }
+        if (!modelReady) {
+            try {
+                await initModel();
+            } catch (error) {
+                postMessage({ msg: 'PROCESSING_FAILED', error: error.message });
+                return;
+            }
+        }
+        const part = inferRange(e.data);
+        postMessage(part, POSTERIORGRAMS.map(name => part[name].buffer));
+    } else if (e.data.msg === 'IMPORT_RESULT') {
+        // Worker pool: take the stitched posteriorgrams of the whole file
+        // and post-process them once; re-renders then work as usual
+        if (!modelReady) {
+            try {
+                await initModel();
+            } catch (error) {
+                postMessage({ msg: 'PROCESSING_FAILED', error: error.message });
+                return;
+            }
+        }
+        importResult(e.data.parts);
+        ensureMidiPointers();
+        loadedModule._bp_notes_to_midi(
+            midiDataPointer, midiSizePointer, ...configToArgs(e.data.config));
+        postMidiResult({ ownedByModule: true });
+    } else if (e.data.msg === 'RERENDER') {
+        // Parameters changed: re-run only the post-processing on the
+        // posteriorgrams kept from the last file
+        if (!loadedModule || typeof loadedModule._bp_notes_to_midi !== 'function') {
+            postMessage({ msg: 'RERENDER_UNSUPPORTED' });
+            return;
+        }
+        ensureMidiPointers();
+
+        const start = performance.now();
+        const midiSize = loadedModule._bp_notes_to_midi(
+            midiDataPointer, midiSizePointer, ...configToArgs(e.data.config));
+        if (midiSize === 0) {
+            // nothing resident (e.g. after SHUTDOWN); the page resends audio
+            postMessage({ msg: 'RERENDER_UNSUPPORTED' });
+            return;
+        }
+        postMidiResult({ ownedByModule: true, rerender: true, ms: performance.now() - start });
+    }
+};
+
+// Posteriorgram bins: 0 notes, 1 onsets, 2 contours
+const POSTERIORGRAMS = ['notes', 'onsets', 'contours'];
+
+function inferRange({ jobId, audioData, audioOffset, totalLength, firstChunk, nChunks }) {
+    const slice = new Float32Array(audioData);
+    ensureAudioBuffer(slice.length * 4);
+    loadedModule.HEAPF32.set(slice, audioPointer >> 2);
+
+    const firstFramePointer = loadedModule._malloc(4);
+    const nFrames = loadedModule._bp_infer_range(
+        audioPointer, slice.length, audioOffset, totalLength, firstChunk,
+        nChunks, BATCH_CHUNKS, firstFramePointer);
+    const firstFrame = loadedModule.getValue(firstFramePointer, 'i32');
+    loadedModule._free(firstFramePointer);
+
+    // copy the frames out of the heap; they are transferred, not cloned
+    const part = { msg: 'RANGE_DONE', jobId, firstFrame, nFrames };
+    const dims = loadedModule._malloc(8);
+    POSTERIORGRAMS.forEach((name, which) => {
+        const data = loadedModule._bp_posteriorgram(which, dims, dims + 4);
+        const nBins = loadedModule.getValue(dims + 4, 'i32');
+        part[name] = data
+            ? loadedModule.HEAPF32.slice(data >> 2, (data >> 2) + nFrames * nBins)
+            : new Float32Array(0);
+        part[name + 'Bins'] = nBins;
+    });
+    loadedModule._free(dims);
+    loadedModule._bp_release_result();
+    return part;
+}
 
-        if (midiData !== 0 && midiSize > 0) {
-            const midiBytes = new Uint8Array(loadedModule.HEAPU8.buffer, midiData, midiSize);
-            const blob = new Blob([midiBytes], { type: 'audio/midi' });
-            postMessage({ msg: 'PROCESSING_DONE', blob });
+// Writes the ranges' frames into the module's posteriorgrams; both sides are
+// column-major, so each bin of a part is one contiguous run
+function importResult(parts) {
+    const nFrames = parts.reduce((end, part) => Math.max(end, part.firstFrame + part.nFrames), 0);
+    POSTERIORGRAMS.forEach((name, which) => {
+        const nBins = parts.reduce((bins, part) => Math.max(bins, part[name + 'Bins']), 0);
+        const data = loadedModule._bp_import_posteriorgram(which, nFrames, nBins);
+        // the heap may have grown, so take the view after the call
+        const heap = loadedModule.HEAPF32;
+        const base = data >> 2;
+        for (const part of parts) {
+            const values = part[name];
+            for (let bin = 0; bin < nBins && part.nFrames > 0; ++bin) {
+                heap.set(values.subarray(bin * part.nFrames, (bin + 1) * part.nFrames),
+                         base + bin * nFrames + part.firstFrame);
+            }
+        }
+    });
+}
+
+// Argument list for the config parameters of the transcription exports,
+// with defaults for anything missing
+function configToArgs(config = {}) {
+    return [
+        config.onset_threshold ?? 0.5,
+        config.frame_threshold ?? 0.3,
+        config.min_frequency ?? 27.5,
+        config.max_frequency ?? 4186.0,
+        config.min_note_length ?? 0.127,
+        config.tempo_bpm ?? 120.0,
+        config.use_melodia_trick ? 1 : 0,
+        config.include_pitch_bends ? 1 : 0
+    ];
+}
+
+function ensureMidiPointers() {
+    if (!midiDataPointer) {
+        midiDataPointer = loadedModule._malloc(4);
+        midiSizePointer = loadedModule._malloc(4);
+    }
+}
+
+// Posts the MIDI data the last call left behind the output pointers
+function postMidiResult({ ownedByModule, rerender = false, ms = 0 }) {
+    const midiData = loadedModule.getValue(midiDataPointer, 'i32');
+    const midiSize = loadedModule.getValue(midiSizePointer, 'i32');
+
+    if (midiData !== 0 && midiSize > 0) {
+        // Module-owned bytes are reused by the next call, and under pthreads
+        // the heap is a SharedArrayBuffer, which Blob rejects: copy first
+        const midiBytes = loadedModule.HEAPU8.slice(midiData, midiData + midiSize);
+        const blob = new Blob([midiBytes], { type: 'audio/midi' });
+        postMessage({ msg: 'PROCESSING_DONE', blob, rerender, ms });
+        if (!ownedByModule) {
             loadedModule._free(midiData);
-        } else {
-            console.error('Failed to generate MIDI data', { midiData, midiSize });
-            postMessage({ msg: 'PROCESSING_FAILED', error: 'Invalid MIDI output' });
         }
+    } else {
+        console.error('Failed to generate MIDI data', { midiData, midiSize });
+        postMessage({ msg: 'PROCESSING_FAILED', error: 'Invalid MIDI output' });
+    }
+}
 
-        // Free allocated WASM memory
-        loadedModule._free(audioPointer);
-        loadedModule._free(midiDataPointer);
-        loadedModule._free(midiSizePointer);
+// Smallest module using a v128 instruction; validates only where wasm SIMD
+// is supported
+const SIMD_PROBE = new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10,
+    1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]);
+
+function supportsSimdThreads() {
+    // SharedArrayBuffer is only exposed on cross-origin isolated pages
+    // (COOP/COEP headers, as set by server.js)
+    if (typeof SharedArrayBuffer === 'undefined' || !self.crossOriginIsolated) {
+        return false;
     }
-};
+    try {
+        return WebAssembly.validate(SIMD_PROBE);
+    } catch (e) {
+        return false;
+    }
+}
+
+async function fetchModel() {
+    if (self.caches) {
+        try {
+            const cache = await caches.open(MODEL_CACHE);
+            let response = await cache.match(MODEL_URL);
+            if (!response) {
+                response = await fetch(MODEL_URL);
+                if (!response.ok) {
+                    throw new Error(`HTTP ${response.status}`);
+                }
+                await cache.put(MODEL_URL, response.clone());
+            }
+            return new Uint8Array(await response.arrayBuffer());
+        } catch (e) {
+            // e.g. storage disabled; fall through to a plain fetch
+            console.warn('Model cache unavailable:', e);
+        }
+    }
+    const response = await fetch(MODEL_URL);
+    if (!response.ok) {
+        throw new Error(`Failed to fetch ${MODEL_URL}: HTTP ${response.status}`);
+    }
+    return new Uint8Array(await response.arrayBuffer());
+}
 
-function loadWASMModule(scriptName) {
-    importScripts(`${scriptName}?v=${Date.now()}`);
-    const modulePromise = libbasicpitch(); // WASM glue code creates this
+// Loads the model into the resident session: the embedded copy if the
+// build has one, otherwise model.ort, copied into the heap only for the
+// duration of bp_init_with_model
+async function initModel() {
+    if (!hasResidentSession()) {
+        modelReady = true; // old builds load the model on every convertToMidi call
+        return;
+    }
+    if (typeof loadedModule._bp_has_embedded_model !== 'function' ||
+        loadedModule._bp_has_embedded_model()) {
+        loadedModule._bp_init();
+        modelReady = true;
+        return;
+    }
 
-    modulePromise.then(mod => {
+    const model = await fetchModel();
+    const modelPointer = loadedModule._malloc(model.length);
+    if (!modelPointer) {
+        throw new Error('Insufficient WASM memory for the model');
+    }
+    loadedModule.HEAPU8.set(model, modelPointer);
+    const ok = loadedModule._bp_init_with_model(modelPointer, model.length);
+    loadedModule._free(modelPointer);
+    if (!ok) {
+        throw new Error('Model initialization failed');
+    }
+    modelReady = true;
+}
+
+// basicpitch.js -> basicpitch-simd-mt.js
+function simdThreadsScriptName(scriptName) {
+    return scriptName.replace(/\.js$/, '-simd-mt.js');
+}
+
+// simdThreads opts in to the SIMD + threads build where the browser
+// supports it
+function loadWASMModule(scriptName, simdThreads = false) {
+    let selectedScript = scriptName;
+    if (simdThreads && supportsSimdThreads()) {
+        try {
+            selectedScript = simdThreadsScriptName(scriptName);
+            importScripts(`${selectedScript}?v=${Date.now()}`);
+        } catch (e) {
+            // not built or not served; use the portable build
+            console.warn(`${selectedScript} unavailable, falling back to ${scriptName}`);
+            selectedScript = scriptName;
+        }
+    }
+    if (selectedScript === scriptName) {
+        importScripts(`${scriptName}?v=${Date.now()}`);
+    }
+    console.log('Using WASM build:', selectedScript);
+
+    // The pthread workers load the glue script themselves, so tell it where
+    // it lives (inside this worker it would otherwise resolve to worker.js)
+    const modulePromise = libbasicpitch({ mainScriptUrlOrBlob: selectedScript }); // WASM glue code creates this
+
+    modulePromise.then(async mod => {
         loadedModule = mod;
+        loadedModule.onInferenceProgress = (chunksDone, totalChunks) => {
+            postMessage({ msg: 'PROGRESS', chunksDone, totalChunks });
+        };
         console.log('WASM module loaded:', Object.keys(loadedModule));
+        if (!hasResidentSession()) {
+            console.warn('basicpitch.wasm has no bp_transcribe export; the model '
+                + 'is reloaded for every file until it is rebuilt with `make wasm`');
+        }
+        if (typeof loadedModule._bp_notes_to_midi !== 'function') {
+            console.warn('basicpitch.wasm has no bp_notes_to_midi export; parameter '
+                + 'changes re-run the model until it is rebuilt with `make wasm`');
+        }
+
+        // Initialize the model now rather than on the first file
+        await initModel();
         postMessage({ msg: 'WASM_READY' });
     }).catch(err => {
         console.error('Failed to load WASM module', err);